@@ -3,64 +3,254 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <type_traits>
+
+/*
+ * Elements are moved around with memcpy and realloc, so T must be
+ * trivially copyable.
+ *
+ * A growable array doubles its capacity when full. A fixed array never
+ * reallocates: appends that don't fit are dropped.
+ */
+
+typedef enum
+{
+    ARRAY_GROW,
+    ARRAY_FIXED,
+} arrayMode_t;
+
+
+// totals across every Array, see ArrayStats()
+typedef struct
+{
+    unsigned long long  allocations; // including reallocations
+    unsigned long long  reallocations;
+    unsigned long long  bytes_allocated; // total ever requested
+    long long           bytes_in_use;
+    long long           peak_bytes;
+    unsigned long long  dropped; // appends to a full fixed array
+} arrayStats_t;
+
+
+inline arrayStats_t * ArrayStats( void ) {
+    static arrayStats_t stats;
+    return &stats;
+}
+
+
+inline void ResetArrayStats( void ) {
+    arrayStats_t * stats = ArrayStats();
+    long long in_use = __atomic_load_n( &stats->bytes_in_use, __ATOMIC_RELAXED );
+    
+    memset( stats, 0, sizeof *stats );
+    stats->bytes_in_use = in_use;
+    stats->peak_bytes = in_use;
+}
+
+
+// old_size is 0 for a new allocation, new_size is 0 for a free
+inline void CountArrayAllocation( size_t old_size, size_t new_size ) {
+    arrayStats_t * stats = ArrayStats();
+    
+    if ( new_size ) {
+        __atomic_fetch_add( &stats->allocations, 1, __ATOMIC_RELAXED );
+        __atomic_fetch_add( &stats->bytes_allocated, new_size, __ATOMIC_RELAXED );
+        if ( old_size ) {
+            __atomic_fetch_add( &stats->reallocations, 1, __ATOMIC_RELAXED );
+        }
+    }
+    
+    long long delta = (long long)new_size - (long long)old_size;
+    long long in_use = __atomic_add_fetch( &stats->bytes_in_use, delta, __ATOMIC_RELAXED );
+    
+    long long peak = __atomic_load_n( &stats->peak_bytes, __ATOMIC_RELAXED );
+    while ( in_use > peak
+           && !__atomic_compare_exchange_n( &stats->peak_bytes,
+                                            &peak,
+                                            in_use,
+                                            true,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED ) )
+        ;
+}
 
 
 template <typename T>
 struct Array {
+    static_assert( std::is_trivially_copyable<T>::value,
+                   "Array elements are copied with memcpy" );
+
     int capacity;
-    int resize_increment;
     int count;
     T * buffer;
-    
-    Array( int size = 64 );
+    arrayMode_t mode;
+
+    Array( int size = 64, arrayMode_t array_mode = ARRAY_GROW );
     ~Array();
-    
-    Array( const Array& array ) {
-        capacity = array.capacity;
-        resize_increment = array.resize_increment;
-        count = array.count;
-        buffer = (T *)malloc( count * sizeof(T) );
-        memcpy(buffer, array.buffer, count * sizeof(T));
-    }
-    
+
+    Array( const Array& array );
+    Array( Array&& array );
+    Array& operator=( const Array& array );
+    Array& operator=( Array&& array );
+
     T * append( T element );
+    int append_range( const T * elements, int num );
     void insert( T element, int index );
     void remove( int index );
     void clear( void );
+    void reserve( int size );
+
+private:
+    bool make_room( int num );
+    void release( void );
 };
 
 
 template <typename T>
-Array<T>::Array( int size ) {
-    capacity = size;
-    resize_increment = size;
+Array<T>::Array( int size, arrayMode_t array_mode ) {
+    capacity = 0;
     count = 0;
-    buffer = (T *)malloc( sizeof(T) * size );
+    buffer = NULL;
+    mode = ARRAY_GROW;
+    
+    reserve( size );
+    mode = array_mode;
+}
+
+
+template <typename T>
+Array<T>::~Array() {
+    release();
+}
+
+
+template <typename T>
+Array<T>::Array( const Array& array ) {
+    capacity = 0;
+    count = 0;
+    buffer = NULL;
+    mode = ARRAY_GROW;
+    
+    reserve( array.capacity );
+    append_range( array.buffer, array.count );
+    mode = array.mode;
+}
+
+
+template <typename T>
+Array<T>::Array( Array&& array ) {
+    capacity = array.capacity;
+    count = array.count;
+    buffer = array.buffer;
+    mode = array.mode;
+    
+    array.capacity = 0;
+    array.count = 0;
+    array.buffer = NULL;
+}
+
+
+template <typename T>
+Array<T>& Array<T>::operator=( const Array& array ) {
+    if ( this != &array ) {
+        count = 0;
+        mode = ARRAY_GROW;
+        reserve( array.count );
+        append_range( array.buffer, array.count );
+        mode = array.mode;
+    }
+
+    return *this;
+}
+
+
+template <typename T>
+Array<T>& Array<T>::operator=( Array&& array ) {
+    if ( this != &array ) {
+        release();
+        
+        capacity = array.capacity;
+        count = array.count;
+        buffer = array.buffer;
+        mode = array.mode;
+        
+        array.capacity = 0;
+        array.count = 0;
+        array.buffer = NULL;
+    }
+
+    return *this;
+}
+
+
+template <typename T>
+void Array<T>::release() {
+    if ( buffer ) {
+        CountArrayAllocation( capacity * sizeof(T), 0 );
+        free( buffer );
+    }
+    
+    buffer = NULL;
+    capacity = 0;
+    count = 0;
+}
+
+
+/*
+ * Make sure there's room for size elements in all, without growing again.
+ * Does nothing to a fixed array.
+ */
+template <typename T>
+void Array<T>::reserve( int size ) {
+    if ( size <= capacity || mode == ARRAY_FIXED ) {
+        return;
+    }
+    
+    size_t old_size = capacity * sizeof(T);
+    size_t new_size = size * sizeof(T);
+    
+    buffer = (T *)realloc( buffer, new_size );
     if ( buffer == NULL ) {
-        fprintf( stderr, "%s: malloc failed\n", __func__ );
+        fprintf( stderr, "%s: realloc failed\n", __func__ );
         exit( EXIT_FAILURE );
     }
+    
+    CountArrayAllocation( old_size, new_size );
+    capacity = size;
 }
 
 
+// returns false if a fixed array is too full
 template <typename T>
-Array<T>::~Array() {
-    free( buffer );
+bool Array<T>::make_room( int num ) {
+    int needed = count + num;
+    if ( needed <= capacity ) {
+        return true;
+    }
+    
+    if ( mode == ARRAY_FIXED ) {
+        __atomic_fetch_add( &ArrayStats()->dropped, 1, __ATOMIC_RELAXED );
+        return false;
+    }
+    
+    int new_capacity = capacity ? capacity * 2 : 8;
+    while ( new_capacity < needed ) {
+        new_capacity *= 2;
+    }
+    
+    reserve( new_capacity );
+    return true;
 }
 
 
+/*
+ * Returns the new element, or NULL if the array is fixed and full.
+ */
 template <typename T>
 T * Array<T>::append( T element ) {
-    if ( count + 1 > capacity ) {
-        size_t new_size = ( capacity + resize_increment ) * sizeof(T);
-        buffer = (T *)realloc( buffer, new_size );
-        
-        if ( buffer == NULL ) {
-            fprintf( stderr, "%s: realloc failed\n", __func__ );
-            exit( EXIT_FAILURE );
-        }
-        
-        capacity += resize_increment;
+    if ( !make_room( 1 ) ) {
+        return NULL;
     }
     
     buffer[count] = element;
@@ -70,11 +260,36 @@ T * Array<T>::append( T element ) {
 }
 
 
+/*
+ * Append num elements at once. Returns the number appended, which is less
+ * than num only if the array is fixed and there wasn't room for them all.
+ */
+template <typename T>
+int Array<T>::append_range( const T * elements, int num ) {
+    if ( num <= 0 ) {
+        return 0;
+    }
+    
+    if ( !make_room( num ) ) {
+        num = capacity - count;
+        if ( num == 0 ) {
+            return 0;
+        }
+    }
+    
+    memcpy( buffer + count, elements, num * sizeof(T) );
+    count += num;
+    
+    return num;
+}
+
+
 template <typename T>
 void Array<T>::insert( T element, int index ) {
     //move existing element at index to the end and replace it
-    append( buffer[index] );
-    buffer[index] = element;
+    if ( append( buffer[index] ) ) {
+        buffer[index] = element;
+    }
 }
 
 
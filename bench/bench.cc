@@ -0,0 +1,706 @@
+/* -----------------------------------------------------------------------------
+ *
+ *  Microbenchmarks for the simulation hot paths
+ *
+ *  Runs headless against libasteroids_sim. Each benchmark is timed one call
+ *  per sample and reported as median and 99th percentile nanoseconds, per
+ *  call and per entity, to a JSON file.
+ *
+ * -------------------------------------------------------------------------- */
+
+#include "mylib.h"
+#include "array.h"
+#include "defines.h"
+#include "fastmath.h"
+#include "entity.h"
+#include "player.h"
+#include "world.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_OUT         "bench.json"
+#define DEFAULT_SAMPLES     200
+#define MIN_SAMPLES         10
+#define SAMPLE_BUDGET_NS    500000000ull // per benchmark and population
+#define MAX_SIZES           16
+#define DEFAULT_SEED        1
+
+typedef struct
+{
+    const char *    name;
+    int             population;
+    int             samples;
+    double          median; // ns per call
+    double          p99;
+    double          per_entity_median;
+    double          per_entity_p99;
+    double          allocations; // by Arrays, per call
+} result_t;
+
+/*
+ * A benchmark times one call of run per sample. setup, if given, runs
+ * untimed before each sample.
+ */
+typedef struct
+{
+    const char *    name;
+    void            (* init)( int population );
+    void            (* setup)( void );
+    void            (* run)( void );
+    void            (* shutdown)( void );
+    int             (* divisor)( void ); // entities touched per call
+} benchmark_t;
+
+static Array<result_t> results;
+static int max_samples = DEFAULT_SAMPLES;
+static broadphase_t broadphase = BROADPHASE_GRID;
+static u64 seed = DEFAULT_SEED;
+
+static u64 Nanoseconds( void ) {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+
+static int CompareDoubles( const void * a, const void * b ) {
+    double d1 = *(const double *)a;
+    double d2 = *(const double *)b;
+    
+    return ( d1 > d2 ) - ( d1 < d2 );
+}
+
+
+static double Percentile( double * sorted, int count, double p ) {
+    int index = (int)( p * count + 0.5 ) - 1;
+    index = MAX( index, 0 );
+    index = MIN( index, count - 1 );
+    
+    return sorted[index];
+}
+
+
+#pragma mark - Fixtures
+
+static world_t * world;
+static int population;
+static float dt = 1.0f / FPS;
+
+// snapshot restored before a sample that modifies the world
+static Array<entity_t> * saved_entities;
+static u32 saved_tick;
+static rng_t saved_rng;
+static particleSystem_t saved_particles;
+
+static void SpawnAsteroids( int count ) {
+    const entityType_t types[] = {
+        ENTITY_ASTEROID_LARGE,
+        ENTITY_ASTEROID_MEDIUM,
+        ENTITY_ASTEROID_SMALL,
+        ENTITY_ASTEROID_SMALL,
+    };
+    
+    for ( int i = 0; i < count; i++ ) {
+        vec2_t pt = { RandomFloat( 0, GAME_WIDTH ), RandomFloat( 0, GAME_HEIGHT ) };
+        entity_t * a = SpawnEntity( world, RANDOM_ELEMENT( types ), pt, 0.0f );
+        
+        a->rotation = RandomFloat( 0, MAX_ANGLE );
+        a->velocity = EntityForward( a ) * RandomFloat( 7.0f, 13.0f );
+        a->angular_speed = RandomFloat( -DEG2RAD( 60 ), DEG2RAD( 60 ) );
+    }
+}
+
+
+// a world of asteroids and no player
+static void InitAsteroids( int n ) {
+    population = n;
+    world = InitWorld( NULL );
+    world->broadphase = broadphase;
+    ClearEntityPool( &world->entities );
+    SpawnAsteroids( n );
+}
+
+
+static void ShutdownWorld( void ) {
+    DestroyWorld( world );
+    world = NULL;
+}
+
+
+static int Population( void ) {
+    return population;
+}
+
+
+/*
+ * The asteroid world, restored before every sample: an update splits and
+ * moves asteroids and spawns particles, and each sample should time the
+ * same workload.
+ */
+static void InitSnapshot( int n ) {
+    InitAsteroids( n );
+    
+    saved_entities = new Array<entity_t>( n );
+    for ( int i = 0; i < world->entities.count; i++ ) {
+        saved_entities->append( *EntityAt( &world->entities, i ) );
+    }
+    saved_tick = world->tick;
+    saved_rng = world->rng;
+}
+
+
+static void SetupSnapshot( void ) {
+    ClearEntityPool( &world->entities );
+    for ( int i = 0; i < saved_entities->count; i++ ) {
+        AddEntity( &world->entities, &saved_entities->buffer[i] );
+    }
+    world->particles.count = 0;
+    world->tick = saved_tick;
+    world->rng = saved_rng;
+}
+
+
+static void ShutdownSnapshot( void ) {
+    delete saved_entities;
+    saved_entities = NULL;
+    ShutdownWorld();
+}
+
+
+static void RunUpdateEntities( void ) {
+    UpdateEntities( world, dt );
+}
+
+
+// just the integration every entity gets, on one thread: the loop that
+// reads only the hot fields
+static void RunMoveEntities( void ) {
+    for ( int i = 0; i < world->entities.count; i++ ) {
+        MoveEntity( EntityAt( &world->entities, i ), dt );
+    }
+}
+
+
+static void RunCollideEntities( void ) {
+    CollideEntities( world );
+}
+
+
+static void RunUpdateWorld( void ) {
+    UpdateWorld( world, dt );
+}
+
+
+#pragma mark - Removal
+
+// every tenth entity is removed each sample
+static void SetupRemove( void ) {
+    SetupSnapshot();
+    for ( int i = 0; i < world->entities.count; i += 10 ) {
+        EntityAt( &world->entities, i )->state = ES_REMOVE;
+    }
+}
+
+
+static void RunRemove( void ) {
+    RemoveDeadEntities( world );
+}
+
+
+#pragma mark - Particles
+
+static void FillParticles( particleSystem_t * ps, int n ) {
+    const int batch = 256;
+    particle_t buffer[batch];
+    
+    for ( int i = 0; i < n; i += batch ) {
+        int num = MIN( batch, n - i );
+        for ( int j = 0; j < num; j++ ) {
+            particle_t * p = &buffer[j];
+            p->position = (vec2_t){ RandomFloat( 0, GAME_WIDTH ), RandomFloat( 0, GAME_HEIGHT ) };
+            p->velocity = (vec2_t){ RandomFloat( -40, 40 ), RandomFloat( -40, 40 ) };
+            p->lifespan = RandomFloat( 0.0f, 1.0f ); // a few expire each tick
+            p->color = (paletteColor_t)Random( 0, NUM_COLORS );
+        }
+        
+        AddParticles( ps, buffer, num );
+    }
+}
+
+
+static void CopyParticles( particleSystem_t * dst, const particleSystem_t * src ) {
+    if ( dst->capacity < src->count ) {
+        FreeParticles( dst );
+        InitParticles( dst, src->capacity );
+    }
+    
+    size_t size = src->count * sizeof(float);
+    memcpy( dst->x, src->x, size );
+    memcpy( dst->y, src->y, size );
+    memcpy( dst->vx, src->vx, size );
+    memcpy( dst->vy, src->vy, size );
+    memcpy( dst->lifespan, src->lifespan, size );
+    memcpy( dst->color, src->color, src->count );
+    dst->count = src->count;
+}
+
+
+static void InitParticleBench( int n ) {
+    population = n;
+    world = InitWorld( NULL );
+    InitParticles( &saved_particles, n );
+    FillParticles( &saved_particles, n );
+}
+
+
+static void SetupParticles( void ) {
+    CopyParticles( &world->particles, &saved_particles );
+}
+
+
+static void RunUpdateParticles( void ) {
+    UpdateParticleSystem( &world->particles, dt );
+}
+
+
+static void ShutdownParticles( void ) {
+    FreeParticles( &saved_particles );
+    ShutdownWorld();
+}
+
+
+#pragma mark - ExplodeEntity
+
+// explode a large asteroid into a particle system already holding n
+static entity_t * exploding;
+static int explode_start;
+
+static void InitExplode( int n ) {
+    InitParticleBench( n );
+    ClearEntityPool( &world->entities );
+    
+    vec2_t center = { GAME_WIDTH / 2.0f, GAME_HEIGHT / 2.0f };
+    exploding = SpawnEntity( world, ENTITY_ASTEROID_LARGE, center, 0.0f );
+    exploding->velocity = (vec2_t){ 10.0f, 0.0f };
+    
+    SetupParticles();
+    explode_start = world->particles.count;
+    ExplodeEntity( world, exploding ); // warm up
+    ApplyCommands( world );
+}
+
+
+static void SetupExplode( void ) {
+    world->particles.count = explode_start;
+}
+
+
+static void RunExplode( void ) {
+    ExplodeEntity( world, exploding );
+    ApplyCommands( world );
+}
+
+
+static int ExplodeDivisor( void ) {
+    return world->particles.count - explode_start; // per particle spawned
+}
+
+
+#pragma mark - SpawnPointBlocked
+
+static entity_t * player;
+
+static void InitSpawnPoint( int n ) {
+    InitAsteroids( n );
+    
+    vec2_t center = { GAME_WIDTH / 2.0f, GAME_HEIGHT / 2.0f };
+    player = SpawnEntity( world, ENTITY_PLAYER, center, PLAYER_START_ROTATION );
+    player->state = ES_RESPAWNING;
+    player->scale = 0.0f;
+}
+
+
+static void RunSpawnPoint( void ) {
+    SpawnPointBlocked( world, player, 3.0f );
+}
+
+
+#pragma mark - Array
+
+static Array<entity_t> * array;
+
+static void InitArray( int n ) {
+    population = n;
+}
+
+
+static void SetupAppend( void ) {
+    delete array;
+    array = new Array<entity_t>( 64 );
+}
+
+
+static void RunAppend( void ) {
+    vec2_t origin = { 0.0f, 0.0f };
+    entity_t asteroid = MakeEntity( ENTITY_ASTEROID_SMALL, origin, 0.0f );
+    
+    for ( int i = 0; i < population; i++ ) {
+        array->append( asteroid );
+    }
+}
+
+
+static void SetupRemoveArray( void ) {
+    SetupAppend();
+    RunAppend();
+}
+
+
+static void RunRemoveArray( void ) {
+    while ( array->count > 0 ) {
+        array->remove( 0 );
+    }
+}
+
+
+static void ShutdownArray( void ) {
+    delete array;
+    array = NULL;
+}
+
+
+static entity_t * range;
+
+static void InitAppendRange( int n ) {
+    population = n;
+    range = (entity_t *)malloc( n * sizeof(entity_t) );
+    vec2_t origin = { 0.0f, 0.0f };
+    for ( int i = 0; i < n; i++ ) {
+        range[i] = MakeEntity( ENTITY_ASTEROID_SMALL, origin, 0.0f );
+    }
+}
+
+
+static void RunAppendRange( void ) {
+    array->append_range( range, population );
+}
+
+
+static void ShutdownAppendRange( void ) {
+    free( range );
+    ShutdownArray();
+}
+
+
+#pragma mark - vec2_t
+
+static vec2_t * vectors;
+static float * angles;
+static volatile float sink;
+
+static void InitRotate( int n ) {
+    population = n;
+    vectors = (vec2_t *)malloc( n * sizeof(vec2_t) );
+    angles = (float *)malloc( n * sizeof(float) );
+    
+    for ( int i = 0; i < n; i++ ) {
+        vectors[i] = (vec2_t){ RandomFloat( -1, 1 ), RandomFloat( -1, 1 ) };
+        angles[i] = RandomFloat( 0, 2.0f * (float)M_PI );
+    }
+}
+
+
+static void RunRotate( void ) {
+    float sum = 0.0f;
+    for ( int i = 0; i < population; i++ ) {
+        vec2_t v = vectors[i].rotated( angles[i] );
+        sum += v.x + v.y;
+    }
+    
+    sink = sum;
+}
+
+
+static void RunRotateVectors( void ) {
+    static vec2_t out[1024];
+    float sum = 0.0f;
+    
+    for ( int start = 0; start < population; start += 1024 ) {
+        int n = MIN( population - start, 1024 );
+        RotateVectors( out, vectors + start, angles + start, n );
+        
+        for ( int i = 0; i < n; i++ ) {
+            sum += out[i].x + out[i].y;
+        }
+    }
+    
+    sink = sum;
+}
+
+
+// the libm version, for comparison
+static void RunSinCos( void ) {
+    float sum = 0.0f;
+    for ( int i = 0; i < population; i++ ) {
+        float s, c;
+        SinCos( angles[i], &s, &c );
+        sum += s + c;
+    }
+    
+    sink = sum;
+}
+
+
+static void RunFastSinCos( void ) {
+    float sum = 0.0f;
+    for ( int i = 0; i < population; i++ ) {
+        float s, c;
+        FastSinCos( angles[i], &s, &c );
+        sum += s + c;
+    }
+    
+    sink = sum;
+}
+
+
+static void ShutdownRotate( void ) {
+    free( vectors );
+    free( angles );
+}
+
+
+#pragma mark - rng_t
+
+static rng_t rng;
+static float * floats;
+
+static void InitRng( int n ) {
+    population = n;
+    SeedRng( &rng, seed, 0 );
+    floats = (float *)malloc( n * sizeof(float) );
+}
+
+
+static void RunRngFloat( void ) {
+    for ( int i = 0; i < population; i++ ) {
+        floats[i] = RngFloat( &rng, 0.0f, 1.0f );
+    }
+}
+
+
+static void RunRngFloats( void ) {
+    RngFloats( &rng, floats, population, 0.0f, 1.0f );
+}
+
+
+static void ShutdownRng( void ) {
+    free( floats );
+}
+
+
+#pragma mark -
+
+static const benchmark_t benchmarks[] = {
+    { "UpdateWorld", InitSnapshot, SetupSnapshot, RunUpdateWorld, ShutdownSnapshot, Population },
+    { "UpdateWorld/move", InitSnapshot, SetupSnapshot, RunMoveEntities, ShutdownSnapshot, Population },
+    { "UpdateWorld/update", InitSnapshot, SetupSnapshot, RunUpdateEntities, ShutdownSnapshot, Population },
+    { "UpdateWorld/collision", InitSnapshot, SetupSnapshot, RunCollideEntities, ShutdownSnapshot, Population },
+    { "UpdateWorld/removal", InitSnapshot, SetupRemove, RunRemove, ShutdownSnapshot, Population },
+    { "UpdateParticles", InitParticleBench, SetupParticles, RunUpdateParticles, ShutdownParticles, Population },
+    { "ExplodeEntity", InitExplode, SetupExplode, RunExplode, ShutdownParticles, ExplodeDivisor },
+    { "SpawnPointBlocked", InitSpawnPoint, NULL, RunSpawnPoint, ShutdownWorld, Population },
+    { "Array/append", InitArray, SetupAppend, RunAppend, ShutdownArray, Population },
+    { "Array/append_range", InitAppendRange, SetupAppend, RunAppendRange, ShutdownAppendRange, Population },
+    { "Array/remove", InitArray, SetupRemoveArray, RunRemoveArray, ShutdownArray, Population },
+    { "vec2_t/rotated", InitRotate, NULL, RunRotate, ShutdownRotate, Population },
+    { "RotateVectors", InitRotate, NULL, RunRotateVectors, ShutdownRotate, Population },
+    { "SinCos", InitRotate, NULL, RunSinCos, ShutdownRotate, Population },
+    { "FastSinCos", InitRotate, NULL, RunFastSinCos, ShutdownRotate, Population },
+    { "rng_t/RngFloat", InitRng, NULL, RunRngFloat, ShutdownRng, Population },
+    { "rng_t/RngFloats", InitRng, NULL, RunRngFloats, ShutdownRng, Population },
+};
+
+
+static void RunBenchmark( const benchmark_t * b, int n ) {
+    double * samples = (double *)malloc( max_samples * sizeof(double) );
+    if ( samples == NULL ) {
+        LOG_BAD_MALLOC;
+        exit( EXIT_FAILURE );
+    }
+    
+    b->init( n );
+    
+    // run until out of samples or out of time, but always take a few
+    int count = 0;
+    int divisor = 1;
+    u64 allocations = 0;
+    u64 budget_start = Nanoseconds();
+    
+    while ( count < max_samples ) {
+        if ( b->setup ) {
+            b->setup();
+        }
+        
+        u64 start_allocations = ArrayStats()->allocations;
+        u64 start = Nanoseconds();
+        b->run();
+        samples[count++] = (double)( Nanoseconds() - start );
+        allocations += ArrayStats()->allocations - start_allocations;
+        
+        // some divisors depend on what the call did
+        divisor = MAX( b->divisor(), 1 );
+        
+        if ( count >= MIN_SAMPLES
+            && Nanoseconds() - budget_start > SAMPLE_BUDGET_NS ) {
+            break;
+        }
+    }
+    
+    b->shutdown();
+    
+    qsort( samples, count, sizeof(double), CompareDoubles );
+    
+    result_t r;
+    r.name = b->name;
+    r.population = n;
+    r.samples = count;
+    r.median = Percentile( samples, count, 0.5 );
+    r.p99 = Percentile( samples, count, 0.99 );
+    r.per_entity_median = r.median / divisor;
+    r.per_entity_p99 = r.p99 / divisor;
+    r.allocations = (double)allocations / count;
+    results.append( r );
+    
+    printf( "%-24s %7d %12.0f %12.0f %10.2f %10.2f %8.1f\n",
+            r.name,
+            r.population,
+            r.median,
+            r.p99,
+            r.per_entity_median,
+            r.per_entity_p99,
+            r.allocations );
+    
+    free( samples );
+}
+
+
+static void WriteResults( const char * path ) {
+    FILE * file = fopen( path, "w" );
+    if ( file == NULL ) {
+        fprintf( stderr, "error: could not open %s\n", path );
+        exit( EXIT_FAILURE );
+    }
+    
+    fprintf( file, "{\n" );
+    fprintf( file, "  \"particle_kernel\": \"%s\",\n",
+             ParticleKernelName( GetParticleKernel() ) );
+    fprintf( file, "  \"broadphase\": \"%s\",\n",
+             broadphase == BROADPHASE_GRID ? "grid" : "brute_force" );
+    fprintf( file, "  \"threads\": %d,\n", GetThreadCount() );
+    fprintf( file, "  \"seed\": %llu,\n", (unsigned long long)seed );
+    fprintf( file, "  \"entity_size\": %zu,\n", sizeof(entity_t) );
+    fprintf( file, "  \"benchmarks\": [\n" );
+    
+    for ( int i = 0; i < results.count; i++ ) {
+        result_t * r = &results.buffer[i];
+        fprintf( file,
+                 "    { \"name\": \"%s\", \"population\": %d, \"samples\": %d, "
+                 "\"median_ns\": %.1f, \"p99_ns\": %.1f, "
+                 "\"median_ns_per_entity\": %.3f, \"p99_ns_per_entity\": %.3f, "
+                 "\"array_allocations\": %.1f }%s\n",
+                 r->name,
+                 r->population,
+                 r->samples,
+                 r->median,
+                 r->p99,
+                 r->per_entity_median,
+                 r->per_entity_p99,
+                 r->allocations,
+                 i + 1 < results.count ? "," : "" );
+    }
+    
+    fprintf( file, "  ]\n}\n" );
+    fclose( file );
+}
+
+
+static void Usage( const char * program ) {
+    fprintf( stderr,
+             "usage: %s [--sizes N,N,...] [--samples N] [--out FILE]\n"
+             "          [--only NAME] [--kernel scalar|sse2|avx] [--bruteforce]\n"
+             "          [--threads N] [--seed N]\n",
+             program );
+    exit( EXIT_FAILURE );
+}
+
+
+int main( int argc, char ** argv ) {
+    int sizes[MAX_SIZES] = { 100, 1000, 5000 };
+    int num_sizes = 3;
+    const char * out = DEFAULT_OUT;
+    const char * only = NULL;
+    
+    for ( int i = 1; i < argc; i++ ) {
+        if ( strcmp( argv[i], "--sizes" ) == 0 && i + 1 < argc ) {
+            num_sizes = 0;
+            for ( char * s = strtok( argv[++i], "," ); s; s = strtok( NULL, "," ) ) {
+                int size = atoi( s );
+                if ( num_sizes < MAX_SIZES && size > 0 ) {
+                    sizes[num_sizes++] = size;
+                }
+            }
+        } else if ( strcmp( argv[i], "--samples" ) == 0 && i + 1 < argc ) {
+            int samples = atoi( argv[++i] );
+            max_samples = MAX( samples, MIN_SAMPLES );
+        } else if ( strcmp( argv[i], "--out" ) == 0 && i + 1 < argc ) {
+            out = argv[++i];
+        } else if ( strcmp( argv[i], "--only" ) == 0 && i + 1 < argc ) {
+            only = argv[++i];
+        } else if ( strcmp( argv[i], "--kernel" ) == 0 && i + 1 < argc ) {
+            const char * name = argv[++i];
+            for ( int k = 0; k < NUM_PARTICLE_KERNELS; k++ ) {
+                if ( strcmp( name, ParticleKernelName( (particleKernel_t)k ) ) == 0 ) {
+                    SetParticleKernel( (particleKernel_t)k );
+                }
+            }
+        } else if ( strcmp( argv[i], "--bruteforce" ) == 0 ) {
+            broadphase = BROADPHASE_BRUTE_FORCE;
+        } else if ( strcmp( argv[i], "--threads" ) == 0 && i + 1 < argc ) {
+            SetThreadCount( atoi( argv[++i] ) );
+        } else if ( strcmp( argv[i], "--seed" ) == 0 && i + 1 < argc ) {
+            seed = strtoull( argv[++i], NULL, 0 );
+        } else {
+            Usage( argv[0] );
+        }
+    }
+    
+    if ( num_sizes == 0 ) {
+        Usage( argv[0] );
+    }
+    
+    SeedRandom( seed );
+    
+    printf( "%-24s %7s %12s %12s %10s %10s %8s\n",
+            "benchmark", "n", "median ns", "p99 ns", "med/ent", "p99/ent", "allocs" );
+    
+    for ( size_t i = 0; i < array_size( benchmarks ); i++ ) {
+        const benchmark_t * b = &benchmarks[i];
+        
+        if ( only && strncmp( b->name, only, strlen( only ) ) != 0 ) {
+            continue;
+        }
+        
+        for ( int s = 0; s < num_sizes; s++ ) {
+            RunBenchmark( b, sizes[s] );
+        }
+    }
+    
+    WriteResults( out );
+    printf( "wrote %s\n", out );
+    
+    return EXIT_SUCCESS;
+}
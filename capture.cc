@@ -0,0 +1,325 @@
+#include "capture.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define PNG_STORED_BLOCK 65535 // most bytes in an uncompressed deflate block
+
+void InitCapture( capture_t * capture ) {
+    memset( capture, 0, sizeof *capture );
+}
+
+
+void FreeCapture( capture_t * capture ) {
+    if ( capture->raw ) {
+        fclose( capture->raw );
+    }
+    
+    delete capture->ticks;
+    memset( capture, 0, sizeof *capture );
+}
+
+
+static bool HasExtension( const char * path, const char * extension ) {
+    size_t path_len = strlen( path );
+    size_t ext_len = strlen( extension );
+    
+    return path_len >= ext_len && strcmp( path + path_len - ext_len, extension ) == 0;
+}
+
+
+/*
+ * Write selected frames to images named by pattern, which must contain a
+ * single %d, for the tick, and end in .ppm or .png.
+ */
+bool SetCaptureImages( capture_t * capture, const char * pattern ) {
+    const char * percent = strchr( pattern, '%' );
+    
+    if ( percent == NULL || percent[1] != 'd' || strchr( percent + 1, '%' ) ) {
+        fprintf( stderr, "%s: %s needs exactly one %%d, for the tick\n", __func__, pattern );
+        return false;
+    }
+    
+    if ( !HasExtension( pattern, ".ppm" ) && !HasExtension( pattern, ".png" ) ) {
+        fprintf( stderr, "%s: %s is not a .ppm or .png\n", __func__, pattern );
+        return false;
+    }
+    
+    capture->image_path = pattern;
+    return true;
+}
+
+
+bool OpenRawCapture( capture_t * capture, const char * path ) {
+    capture->raw = fopen( path, "wb" );
+    if ( capture->raw == NULL ) {
+        fprintf( stderr, "%s: could not open %s\n", __func__, path );
+        return false;
+    }
+    
+    // frames are written whole, straight from the framebuffer; buffering
+    // would only add a copy
+    setvbuf( capture->raw, NULL, _IONBF, 0 );
+    
+    return true;
+}
+
+
+// list is tick numbers separated by commas, e.g. "60,600,1800"
+bool ParseCaptureTicks( capture_t * capture, const char * list ) {
+    if ( capture->ticks == NULL ) {
+        capture->ticks = new Array<int>;
+    }
+    
+    const char * p = list;
+    while ( *p ) {
+        char * end;
+        long tick = strtol( p, &end, 10 );
+        
+        if ( end == p || tick < 0 || ( *end != ',' && *end != '\0' ) ) {
+            fprintf( stderr, "%s: bad tick list '%s'\n", __func__, list );
+            return false;
+        }
+        
+        capture->ticks->append( (int)tick );
+        p = *end == ',' ? end + 1 : end;
+    }
+    
+    return true;
+}
+
+
+bool CaptureSelected( const capture_t * capture, int tick ) {
+    if ( capture->every <= 0 && capture->ticks == NULL ) {
+        return true;
+    }
+    
+    if ( capture->every > 0 && tick % capture->every == 0 ) {
+        return true;
+    }
+    
+    if ( capture->ticks ) {
+        for ( int i = 0; i < capture->ticks->count; i++ ) {
+            if ( capture->ticks->buffer[i] == tick ) {
+                return true;
+            }
+        }
+    }
+    
+    return false;
+}
+
+
+/*
+ * Save the frame just drawn if tick is selected. Returns false if writing
+ * failed.
+ */
+bool CaptureFrame
+ (  capture_t * capture,
+    const framebuffer_t * fb,
+    const u32 colors[256],
+    int tick )
+{
+    if ( !CaptureSelected( capture, tick ) ) {
+        return true;
+    }
+    
+    bool ok = true;
+    size_t size = fb->width * fb->height;
+    
+    if ( capture->raw && fwrite( fb->pixels, 1, size, capture->raw ) != size ) {
+        fprintf( stderr, "%s: could not write frame %d\n", __func__, tick );
+        ok = false;
+    }
+    
+    if ( capture->image_path ) {
+        char path[1024];
+        snprintf( path, sizeof path, capture->image_path, tick );
+        
+        if ( HasExtension( path, ".png" ) ) {
+            ok = WritePNG( fb, colors, path ) && ok;
+        } else {
+            ok = WritePPM( fb, colors, path ) && ok;
+        }
+    }
+    
+    capture->num_captured++;
+    
+    return ok;
+}
+
+
+bool WritePPM( const framebuffer_t * fb, const u32 colors[256], const char * path ) {
+    FILE * file = fopen( path, "wb" );
+    if ( file == NULL ) {
+        fprintf( stderr, "%s: could not open %s\n", __func__, path );
+        return false;
+    }
+    
+    fprintf( file, "P6\n%d %d\n255\n", fb->width, fb->height );
+    
+    u8 * row = (u8 *)malloc( fb->width * 3 );
+    if ( row == NULL ) {
+        LOG_BAD_MALLOC;
+        exit( EXIT_FAILURE );
+    }
+    
+    bool ok = true;
+    for ( int y = 0; y < fb->height && ok; y++ ) {
+        const u8 * src = fb->pixels + y * fb->width;
+        
+        for ( int x = 0; x < fb->width; x++ ) {
+            u32 c = colors[src[x]];
+            row[x * 3 + 0] = (u8)( c >> 16 );
+            row[x * 3 + 1] = (u8)( c >> 8 );
+            row[x * 3 + 2] = (u8)c;
+        }
+        
+        ok = fwrite( row, 3, fb->width, file ) == (size_t)fb->width;
+    }
+    
+    free( row );
+    
+    if ( fclose( file ) != 0 ) {
+        ok = false;
+    }
+    
+    if ( !ok ) {
+        fprintf( stderr, "%s: could not write %s\n", __func__, path );
+    }
+    
+    return ok;
+}
+
+
+//
+// PNG
+//
+// Written as an 8-bit paletted image with uncompressed (stored) deflate
+// blocks: no zlib needed, and it's about the size of the framebuffer.
+//
+
+static u32 crc_table[256];
+
+static u32 Crc32( u32 crc, const u8 * data, size_t size ) {
+    if ( crc_table[1] == 0 ) {
+        for ( u32 n = 0; n < 256; n++ ) {
+            u32 c = n;
+            for ( int k = 0; k < 8; k++ ) {
+                c = c & 1 ? 0xEDB88320 ^ ( c >> 1 ) : c >> 1;
+            }
+            crc_table[n] = c;
+        }
+    }
+    
+    crc = ~crc;
+    for ( size_t i = 0; i < size; i++ ) {
+        crc = crc_table[( crc ^ data[i] ) & 0xFF] ^ ( crc >> 8 );
+    }
+    
+    return ~crc;
+}
+
+
+static void PutBE32( Array<u8> * out, u32 value ) {
+    u8 bytes[4] = {
+        (u8)( value >> 24 ),
+        (u8)( value >> 16 ),
+        (u8)( value >> 8 ),
+        (u8)value
+    };
+    out->append_range( bytes, 4 );
+}
+
+
+static void PutChunk( Array<u8> * out, const char * type, const u8 * data, u32 size ) {
+    PutBE32( out, size );
+    
+    int start = out->count;
+    out->append_range( (const u8 *)type, 4 );
+    out->append_range( data, size );
+    
+    PutBE32( out, Crc32( 0, out->buffer + start, size + 4 ) );
+}
+
+
+bool WritePNG( const framebuffer_t * fb, const u32 colors[256], const char * path ) {
+    static const u8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    
+    Array<u8> png( 1 << 16 );
+    png.append_range( signature, sizeof signature );
+    
+    Array<u8> data( 1 << 16 );
+    
+    // width, height, 8 bits, indexed color, deflate, standard filters, not
+    // interlaced
+    PutBE32( &data, fb->width );
+    PutBE32( &data, fb->height );
+    const u8 ihdr_tail[5] = { 8, 3, 0, 0, 0 };
+    data.append_range( ihdr_tail, sizeof ihdr_tail );
+    PutChunk( &png, "IHDR", data.buffer, data.count );
+    
+    data.clear();
+    for ( int i = 0; i < 256; i++ ) {
+        const u8 rgb[3] = { (u8)( colors[i] >> 16 ), (u8)( colors[i] >> 8 ), (u8)colors[i] };
+        data.append_range( rgb, 3 );
+    }
+    PutChunk( &png, "PLTE", data.buffer, data.count );
+    
+    // each row is a filter type byte (none) and the indices
+    Array<u8> rows( ( fb->width + 1 ) * fb->height );
+    for ( int y = 0; y < fb->height; y++ ) {
+        rows.append( 0 );
+        rows.append_range( fb->pixels + y * fb->width, fb->width );
+    }
+    
+    // zlib stream of stored blocks, then the Adler-32 of the rows
+    data.clear();
+    const u8 zlib_header[2] = { 0x78, 0x01 };
+    data.append_range( zlib_header, sizeof zlib_header );
+    
+    u32 a = 1;
+    u32 b = 0;
+    for ( int i = 0; i < rows.count; i++ ) {
+        a = ( a + rows.buffer[i] ) % 65521;
+        b = ( b + a ) % 65521;
+    }
+    
+    int offset = 0;
+    do {
+        int size = MIN( rows.count - offset, PNG_STORED_BLOCK );
+        bool final = offset + size == rows.count;
+        const u8 block_header[5] = {
+            (u8)final,
+            (u8)size,
+            (u8)( size >> 8 ),
+            (u8)~size,
+            (u8)( ~size >> 8 )
+        };
+        data.append_range( block_header, sizeof block_header );
+        data.append_range( rows.buffer + offset, size );
+        offset += size;
+    } while ( offset < rows.count );
+    
+    PutBE32( &data, ( b << 16 ) | a );
+    PutChunk( &png, "IDAT", data.buffer, data.count );
+    PutChunk( &png, "IEND", NULL, 0 );
+    
+    FILE * file = fopen( path, "wb" );
+    if ( file == NULL ) {
+        fprintf( stderr, "%s: could not open %s\n", __func__, path );
+        return false;
+    }
+    
+    bool ok = fwrite( png.buffer, 1, png.count, file ) == (size_t)png.count;
+    
+    if ( fclose( file ) != 0 ) {
+        ok = false;
+    }
+    
+    if ( !ok ) {
+        fprintf( stderr, "%s: could not write %s\n", __func__, path );
+    }
+    
+    return ok;
+}
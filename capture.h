@@ -0,0 +1,53 @@
+#ifndef capture_h
+#define capture_h
+
+/*
+ * Saving frames drawn by the software renderer, for golden image tests and
+ * for measuring drawing on machines without a display.
+ *
+ * Selected frames are written as images, PPM or indexed PNG depending on
+ * the path's extension, with the tick number filled in for its %d. They
+ * can also be streamed to a raw file: each frame is width * height palette
+ * indices, written straight from the framebuffer, back to back with no
+ * header. The file can be a pipe (a fifo, or /dev/fd/N) for another
+ * process to read as they're drawn.
+ *
+ * With neither every nor ticks set, every frame is selected.
+ */
+
+#include "mylib.h"
+#include "array.h"
+#include "raster.h"
+
+#include <stdio.h>
+
+typedef struct
+{
+    const char *    image_path; // pattern with a %d, or NULL for no images
+    FILE *          raw; // or NULL
+
+    // which ticks to capture
+    int             every; // multiples of this, if > 0
+    Array<int> *    ticks; // and these, if not NULL
+
+    int             num_captured;
+} capture_t;
+
+void    InitCapture( capture_t * capture );
+void    FreeCapture( capture_t * capture );
+bool    SetCaptureImages( capture_t * capture, const char * pattern );
+bool    OpenRawCapture( capture_t * capture, const char * path );
+bool    ParseCaptureTicks( capture_t * capture, const char * list );
+
+bool    CaptureSelected( const capture_t * capture, int tick );
+bool    CaptureFrame
+ (  capture_t * capture,
+    const framebuffer_t * fb,
+    const u32 colors[256],
+    int tick );
+
+// colors are ARGB8888, as made for the software renderer
+bool    WritePPM( const framebuffer_t * fb, const u32 colors[256], const char * path );
+bool    WritePNG( const framebuffer_t * fb, const u32 colors[256], const char * path );
+
+#endif /* capture_h */
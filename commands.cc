@@ -0,0 +1,36 @@
+#include "commands.h"
+
+void InitCommandBuffer( commandBuffer_t * commands ) {
+    commands->spawns = new Array<entity_t>( 16 );
+    commands->particles = new Array<particle_t>( 256 );
+}
+
+
+void FreeCommandBuffer( commandBuffer_t * commands ) {
+    delete commands->spawns;
+    delete commands->particles;
+    commands->spawns = NULL;
+    commands->particles = NULL;
+}
+
+
+void ClearCommandBuffer( commandBuffer_t * commands ) {
+    commands->spawns->clear();
+    commands->particles->clear();
+}
+
+
+void ApplyCommandBuffer
+ (  commandBuffer_t * commands,
+    entityPool_t * entities,
+    particleSystem_t * particles )
+{
+    for ( int i = 0; i < commands->spawns->count; i++ ) {
+        AddEntity( entities, &commands->spawns->buffer[i] );
+    }
+    
+    // one batch for all bursts
+    AddParticles( particles, commands->particles->buffer, commands->particles->count );
+    
+    ClearCommandBuffer( commands );
+}
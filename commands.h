@@ -0,0 +1,35 @@
+#ifndef commands_h
+#define commands_h
+
+/*
+ * Structural changes to the world requested during an update: entities
+ * to spawn and particles to add. Recording them here instead of making
+ * them on the spot means nothing is added to world->entities or
+ * world->particles while UpdateWorld is looping over them. They are all
+ * applied at once, in the order they were recorded, at the end of the
+ * update.
+ *
+ * (Removal needs no command: entities are marked ES_REMOVE and stay put
+ * until RemoveDeadEntities.)
+ */
+
+#include "array.h"
+#include "entity.h"
+#include "entitypool.h"
+#include "particles.h"
+
+typedef struct
+{
+    Array<entity_t> *   spawns;
+    Array<particle_t> * particles;
+} commandBuffer_t;
+
+void    InitCommandBuffer( commandBuffer_t * commands );
+void    FreeCommandBuffer( commandBuffer_t * commands );
+void    ClearCommandBuffer( commandBuffer_t * commands );
+void    ApplyCommandBuffer
+ (  commandBuffer_t * commands,
+    entityPool_t * entities,
+    particleSystem_t * particles );
+
+#endif /* commands_h */
@@ -9,6 +9,8 @@
 #define GAME_HEIGHT 200
 #define SCALE 3
 
+#define PALETTE_FILE "default.pal"
+
 #define MAX_ANGLE (M_PI * 2.0f)
 #define DEG2RAD(a) ( ((a) * M_PI) / 180.0f )
 #define RAD2DEG(a) ( ((a) * 180.0f) / M_PI )
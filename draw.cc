@@ -2,10 +2,19 @@
 #include "draw.h"
 #include "defines.h"
 #include "entity.h"
+#include "world.h"
+#include "game.h"
+#include "utility.h"
+#include "profile.h"
+#include "pack.h"
+#include "raster.h"
 
 #include "sprite.h"
 #include "mylib.h"
+#include "array.h"
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 
 SDL_Window * window;
 SDL_Renderer * renderer;
@@ -13,9 +22,386 @@ Palette palette;
 Sprite sprites[NUM_ENTITY_TYPES];
 bool fullscreen;
 
+// assets, if they came from a pack; sprites point into it
+static pack_t pack;
+
+// points waiting to be drawn, one list per color, reused every frame
+static Array<SDL_Point> point_batches[NUM_COLORS];
+
+// every frame of every sprite, packed into one texture
+static SDL_Texture * atlas;
+static int atlas_width;
+static int atlas_height;
+static SDL_Rect atlas_rects[NUM_ENTITY_TYPES][SPRITE_MAX_FRAMES];
+
+// optionally, each sprite pre-rendered at a number of angles (and, for
+// sprites that grow in, scales), so drawing needs no rotation. When
+// enabled, the atlas holds these instead.
+static struct {
+    int             angle_steps; // 0 if disabled
+    int             scale_steps;
+    int             first[NUM_ENTITY_TYPES]; // into rects
+    int             num_scales[NUM_ENTITY_TYPES];
+    Array<SDL_Rect> rects; // [scale][angle] for each type
+} rotation_cache = { .scale_steps = SPRITE_SCALE_STEPS };
+
+// position in an atlas being filled, left to right in rows
+typedef struct {
+    int x;
+    int y;
+    int row_height;
+    int width;
+} atlasCursor_t;
+
+// sprite quads waiting to be drawn, reused every frame
+static Array<SDL_Vertex> sprite_vertices;
+static Array<int> sprite_indices;
+
+// the stars, baked into one texture per parallax layer
+static struct {
+    int             num_layers;
+    float           speed; // of the nearest layer, in pixels per second
+    SDL_Texture *   layers[MAX_STAR_LAYERS];
+    
+    // what the textures were built with
+    bool            valid;
+    Palette         palette;
+    int             width;
+    int             height;
+} starfield = { .num_layers = 1 };
+
+// the software renderer: everything is drawn into an indexed framebuffer
+// on the CPU, then converted and uploaded to one streaming texture per
+// frame. With no window (texture is NULL) frames are converted into rgb.
+static struct {
+    bool            enabled;
+    framebuffer_t   fb;
+    u32             colors[256]; // ARGB8888 for each palette index
+    SDL_Texture *   texture;
+    u32 *           rgb;
+} software;
+
+static void FreeStarfield() {
+    for ( int i = 0; i < MAX_STAR_LAYERS; i++ ) {
+        if ( starfield.layers[i] ) {
+            SDL_DestroyTexture( starfield.layers[i] );
+            starfield.layers[i] = NULL;
+        }
+    }
+    
+    starfield.valid = false;
+}
+
+
 static void FreeSprites() {
     for ( int i = 0; i < NUM_ENTITY_TYPES; i++ ) {
-        SDL_DestroyTexture( sprites[i].texture );
+        FreeSprite( &sprites[i] );
+    }
+    
+    ClosePack( &pack );
+    
+    if ( atlas ) {
+        SDL_DestroyTexture( atlas );
+        atlas = NULL;
+    }
+    
+    FreeStarfield();
+}
+
+
+static void FreeSoftwareRenderer() {
+    if ( software.texture ) {
+        SDL_DestroyTexture( software.texture );
+    }
+    
+    FreeFramebuffer( &software.fb );
+    free( software.rgb );
+    memset( &software, 0, sizeof software );
+}
+
+
+/*
+ * Find room for a w * h rect, starting a new row if this one is full and
+ * leaving a pixel of padding so filtering never bleeds between rects.
+ */
+static SDL_Rect AtlasAlloc( atlasCursor_t * cursor, int w, int h ) {
+    if ( cursor->x + w > cursor->width ) {
+        cursor->x = 0;
+        cursor->y += cursor->row_height + 1;
+        cursor->row_height = 0;
+    }
+    
+    SDL_Rect r = { cursor->x, cursor->y, w, h };
+    cursor->x += w + 1;
+    cursor->row_height = MAX( cursor->row_height, h );
+    
+    return r;
+}
+
+
+static int AtlasHeight( const atlasCursor_t * cursor ) {
+    return cursor->y + cursor->row_height;
+}
+
+
+static void PutAtlasPixel( SDL_Surface * surface, int x, int y, u8 index ) {
+    if ( index == SPRITE_TRANSPARENT ) {
+        return;
+    }
+    
+    SDL_Color c = palette.colors[index];
+    u8 * pixel = (u8 *)surface->pixels + y * surface->pitch + x * 4;
+    pixel[0] = c.r;
+    pixel[1] = c.g;
+    pixel[2] = c.b;
+    pixel[3] = 255;
+}
+
+
+static void PackFrames() {
+    atlasCursor_t cursor = { .width = ATLAS_WIDTH };
+    
+    for ( int i = 0; i < NUM_ENTITY_TYPES; i++ ) {
+        Sprite * s = &sprites[i];
+        
+        for ( int frame = 0; frame < s->num_frames; frame++ ) {
+            atlas_rects[i][frame] = AtlasAlloc( &cursor, s->width, s->height );
+        }
+    }
+    
+    atlas_width = cursor.width;
+    atlas_height = AtlasHeight( &cursor );
+}
+
+
+static void DrawFrames( SDL_Surface * surface ) {
+    for ( int i = 0; i < NUM_ENTITY_TYPES; i++ ) {
+        Sprite * s = &sprites[i];
+        
+        for ( int frame = 0; frame < s->num_frames; frame++ ) {
+            SDL_Rect * r = &atlas_rects[i][frame];
+            u8 * pixels = SpriteFrame( s, frame );
+            
+            for ( int y = 0; y < r->h; y++ ) {
+                for ( int x = 0; x < r->w; x++ ) {
+                    PutAtlasPixel( surface, r->x + x, r->y + y, pixels[y * r->w + x] );
+                }
+            }
+        }
+    }
+}
+
+
+// the size of a sprite drawn at scale, as DrawSprite sizes it
+static SDL_Rect ScaledSpriteRect( const Sprite * s, float scale ) {
+    return (SDL_Rect){
+        0,
+        0,
+        (int)( (float)s->width * scale ),
+        (int)( (float)s->height * scale )
+    };
+}
+
+
+// big enough to hold the sprite at any angle
+static int RotatedSize( SDL_Rect r ) {
+    return (int)ceilf( sqrtf( (float)( r.w * r.w + r.h * r.h ) ) );
+}
+
+
+static void PackRotations() {
+    atlasCursor_t cursor = { .width = ROTATION_ATLAS_WIDTH };
+    rotation_cache.rects.clear();
+    
+    for ( int i = 0; i < NUM_ENTITY_TYPES; i++ ) {
+        Sprite * s = &sprites[i];
+        int num_scales = entity_defs[i].flags & FL_SCALES ? rotation_cache.scale_steps : 1;
+        
+        rotation_cache.first[i] = rotation_cache.rects.count;
+        rotation_cache.num_scales[i] = num_scales;
+        
+        for ( int step = 1; step <= num_scales; step++ ) {
+            int size = RotatedSize( ScaledSpriteRect( s, (float)step / num_scales ) );
+            
+            for ( int angle = 0; angle < rotation_cache.angle_steps; angle++ ) {
+                rotation_cache.rects.append( AtlasAlloc( &cursor, size, size ) );
+            }
+        }
+    }
+    
+    atlas_width = cursor.width;
+    atlas_height = AtlasHeight( &cursor );
+}
+
+
+/*
+ * Render frame 0 of each sprite into its cache cells, rotating (clockwise,
+ * about the center) and scaling with nearest neighbour sampling.
+ */
+static void DrawRotations( SDL_Surface * surface ) {
+    for ( int i = 0; i < NUM_ENTITY_TYPES; i++ ) {
+        Sprite * s = &sprites[i];
+        u8 * pixels = SpriteFrame( s, 0 );
+        int num_scales = rotation_cache.num_scales[i];
+        SDL_Rect * rect = &rotation_cache.rects.buffer[rotation_cache.first[i]];
+        
+        for ( int step = 1; step <= num_scales; step++ ) {
+            SDL_Rect scaled = ScaledSpriteRect( s, (float)step / num_scales );
+            float to_src_x = (float)s->width / MAX( scaled.w, 1 );
+            float to_src_y = (float)s->height / MAX( scaled.h, 1 );
+            
+            for ( int angle = 0; angle < rotation_cache.angle_steps; angle++, rect++ ) {
+                float radians = angle * ( 2.0f * (float)M_PI ) / rotation_cache.angle_steps;
+                float c = cosf( radians );
+                float sn = sinf( radians );
+                float half = rect->w * 0.5f;
+                
+                for ( int y = 0; y < rect->h; y++ ) {
+                    for ( int x = 0; x < rect->w; x++ ) {
+                        // rotate the pixel center back into the scaled sprite
+                        float dx = x + 0.5f - half;
+                        float dy = y + 0.5f - half;
+                        float sx = dx * c + dy * sn + scaled.w * 0.5f;
+                        float sy = -dx * sn + dy * c + scaled.h * 0.5f;
+                        
+                        if ( sx < 0.0f || sy < 0.0f || sx >= scaled.w || sy >= scaled.h ) {
+                            continue;
+                        }
+                        
+                        int px = (int)( sx * to_src_x );
+                        int py = (int)( sy * to_src_y );
+                        PutAtlasPixel( surface,
+                                       rect->x + x,
+                                       rect->y + y,
+                                       pixels[py * s->width + px] );
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+static bool AtlasFits( int width, int height ) {
+    SDL_RendererInfo info;
+    if ( SDL_GetRendererInfo( renderer, &info ) != 0 ) {
+        return true; // find out when creating it
+    }
+    
+    // zero means no limit
+    return ( info.max_texture_width == 0 || width <= info.max_texture_width )
+        && ( info.max_texture_height == 0 || height <= info.max_texture_height );
+}
+
+
+static void BuildAtlas() {
+    if ( atlas ) {
+        SDL_DestroyTexture( atlas );
+        atlas = NULL;
+    }
+    
+    PackFrames();
+    
+    if ( rotation_cache.angle_steps > 0 ) {
+        PackRotations();
+        
+        if ( !AtlasFits( atlas_width, atlas_height ) ) {
+            fprintf( stderr,
+                     "%s: %d rotations need a %dx%d atlas, too big for this "
+                     "renderer; rotating at draw time instead\n",
+                     __func__,
+                     rotation_cache.angle_steps,
+                     atlas_width,
+                     atlas_height );
+            rotation_cache.angle_steps = 0;
+            PackFrames();
+        }
+    }
+    
+    SDL_Surface * surface = SDL_CreateRGBSurfaceWithFormat( 0,
+                                                            atlas_width,
+                                                            atlas_height,
+                                                            32,
+                                                            SDL_PIXELFORMAT_RGBA32 );
+    if ( surface == NULL ) {
+        LOG_SDL_ERROR;
+        exit( EXIT_FAILURE );
+    }
+    
+    SDL_LockSurface( surface );
+    memset( surface->pixels, 0, surface->pitch * surface->h );
+    
+    if ( rotation_cache.angle_steps > 0 ) {
+        DrawRotations( surface );
+    } else {
+        DrawFrames( surface );
+    }
+    
+    SDL_UnlockSurface( surface );
+    
+    atlas = SDL_CreateTextureFromSurface( renderer, surface );
+    SDL_FreeSurface( surface );
+    
+    if ( atlas == NULL ) {
+        LOG_SDL_ERROR;
+        exit( EXIT_FAILURE );
+    }
+    
+    SDL_SetTextureBlendMode( atlas, SDL_BLENDMODE_BLEND );
+}
+
+
+/*
+ * Pre-render sprites at angle_steps angles (and scale_steps sizes, for
+ * those that grow in) instead of rotating them as they're drawn. More
+ * steps look smoother and take more texture memory. Zero angle_steps
+ * turns the cache off.
+ */
+void SetRotationCache( int angle_steps, int scale_steps ) {
+    rotation_cache.angle_steps = MAX( angle_steps, 0 );
+    rotation_cache.scale_steps = MAX( scale_steps, 1 );
+    
+    if ( renderer ) {
+        BuildAtlas();
+    }
+}
+
+
+/*
+ * Load the palette and sprites from the asset pack if there is one,
+ * otherwise (or for anything missing from it) from the loose files.
+ */
+static void LoadAssets() {
+    bool have_pack = OpenPack( &pack, PACK_FILE );
+    
+    u32 size;
+    const u8 * data = NULL;
+    
+    if ( have_pack ) {
+        data = FindPackEntry( &pack, PALETTE_FILE, &size );
+    }
+    
+    palette = data ? PaletteFromMemory( data, size ) : LoadPalette( PALETTE_FILE );
+    
+    for ( int i = 0; i < NUM_ENTITY_TYPES; i++ ) {
+        const char * name = entity_defs[i].sprite_name;
+        
+        data = NULL;
+        if ( have_pack ) {
+            data = FindPackEntry( &pack, name, &size );
+        }
+        
+        // no texture of its own, everything is drawn from the atlas
+        if ( data == NULL || !SpriteFromMemory( &sprites[i], data, size ) ) {
+            if ( have_pack ) {
+                fprintf( stderr, "%s: %s not in %s\n", __func__, name, PACK_FILE );
+            }
+            LoadSpriteData( &sprites[i], name );
+        }
+    }
+    
+    if ( have_pack ) {
+        printf( "loaded assets from %s\n", PACK_FILE );
     }
 }
 
@@ -41,13 +427,57 @@ void InitRenderer() {
         fprintf(stderr, "SDL error: %s\n", SDL_GetError());
     
     SDL_RenderSetLogicalSize( renderer, GAME_WIDTH, GAME_HEIGHT );
-    palette = LoadPalette( "default.pal" );
+    LoadAssets();
+    BuildAtlas();
+    atexit( FreeSprites );
+}
+
+
+/*
+ * Draw everything on the CPU instead, into a GAME_WIDTH * GAME_HEIGHT
+ * framebuffer of palette indices. With a window (after InitWindow), each
+ * frame is converted to color and uploaded with a single texture update.
+ * Without one nothing is shown, but frames are still drawn and converted,
+ * e.g. to measure drawing in a headless run.
+ */
+void InitSoftwareRenderer( bool windowed ) {
+    LoadAssets();
+    atexit( FreeSprites );
     
-    for ( int i = 0; i < NUM_ENTITY_TYPES; i++ ) {
-        sprites[i] = LoadSprite( renderer, entity_defs[i].sprite_name, palette );
+    InitFramebuffer( &software.fb, GAME_WIDTH, GAME_HEIGHT );
+    
+    for ( int i = 0; i < palette.num_colors; i++ ) {
+        SDL_Color c = palette.colors[i];
+        software.colors[i] = 0xFF000000 | c.r << 16 | c.g << 8 | c.b;
     }
     
-    atexit( FreeSprites );
+    if ( windowed ) {
+        renderer = SDL_CreateRenderer( window, -1, 0 );
+        if ( renderer == NULL ) {
+            LOG_SDL_ERROR;
+            exit( EXIT_FAILURE );
+        }
+        
+        SDL_RenderSetLogicalSize( renderer, GAME_WIDTH, GAME_HEIGHT );
+        software.texture = SDL_CreateTexture( renderer,
+                                              SDL_PIXELFORMAT_ARGB8888,
+                                              SDL_TEXTUREACCESS_STREAMING,
+                                              GAME_WIDTH,
+                                              GAME_HEIGHT );
+        if ( software.texture == NULL ) {
+            LOG_SDL_ERROR;
+            exit( EXIT_FAILURE );
+        }
+    } else {
+        software.rgb = (u32 *)malloc( GAME_WIDTH * GAME_HEIGHT * sizeof(u32) );
+        if ( software.rgb == NULL ) {
+            LOG_BAD_MALLOC;
+            exit( EXIT_FAILURE );
+        }
+    }
+    
+    software.enabled = true;
+    atexit( FreeSoftwareRenderer );
 }
 
 
@@ -57,33 +487,131 @@ void ToggleFullscreen() {
 }
 
 
+/*
+ * Software DrawSprite: blit straight into the framebuffer, rotating in
+ * the blit when needed.
+ */
+static void DrawSpriteSoftware( int type, int x, int y, double angle, float scale ) {
+    const Sprite * s = &sprites[type];
+    rasterImage_t image = { SpriteFrame( s, 0 ), s->width, s->height };
+    int w = (int)( (float)s->width * scale );
+    int h = (int)( (float)s->height * scale );
+    
+    if ( angle == 0.0 && w == s->width && h == s->height ) {
+        BlitImage( &software.fb, &image, x, y );
+        return;
+    }
+    
+    BlitRotated( &software.fb,
+                 &image,
+                 x + w * 0.5f,
+                 y + h * 0.5f,
+                 w,
+                 h,
+                 DEG2RAD( angle ) );
+}
+
+
+/*
+ * Queue a sprite to be drawn at the next FlushSprites. (x, y) is the top
+ * left corner before rotation, and the sprite is rotated angle degrees
+ * clockwise about its center, as with SDL_RenderCopyEx.
+ */
 void DrawSprite( int type, int x, int y, double angle, float scale ) {
-    Sprite * s = &sprites[type];
+    if ( software.enabled ) {
+        DrawSpriteSoftware( type, x, y, angle, scale );
+        return;
+    }
+    
+    SDL_Rect * src = &atlas_rects[type][0];
     
-    SDL_Rect src = { 0, 0, s->data.width, s->data.height };
     SDL_Rect dst = {
         .x = x,
         .y = y,
-        .w = (int)((float)s->data.width * scale),
-        .h = (int)((float)s->data.height * scale)
+        .w = (int)((float)src->w * scale),
+        .h = (int)((float)src->h * scale)
+    };
+    
+    if ( dst.w == 0 || dst.h == 0 ) {
+        return;
+    }
+    
+    float hw = dst.w * 0.5f;
+    float hh = dst.h * 0.5f;
+    float cx = dst.x + hw;
+    float cy = dst.y + hh;
+    
+    if ( rotation_cache.angle_steps > 0 ) {
+        // already rotated, use the nearest one as is
+        int steps = rotation_cache.angle_steps;
+        int a = (int)floor( angle * steps / 360.0 + 0.5 ) % steps;
+        if ( a < 0 ) {
+            a += steps;
+        }
+        
+        int num_scales = rotation_cache.num_scales[type];
+        int step = 1;
+        if ( num_scales > 1 ) {
+            // too small for the smallest step: not drawn, as when uncached
+            step = MIN( (int)( scale * num_scales + 0.5f ), num_scales );
+            if ( step == 0 ) {
+                return;
+            }
+        }
+        
+        int index = rotation_cache.first[type] + ( step - 1 ) * steps + a;
+        src = &rotation_cache.rects.buffer[index];
+        
+        // sprites that don't have the scale cached are stretched to it
+        float size = num_scales > 1 ? src->w : src->w * scale;
+        hw = hh = size * 0.5f;
+        cx = floorf( cx - hw ) + hw;
+        cy = floorf( cy - hh ) + hh;
+        angle = 0.0;
+    }
+    
+    float radians = DEG2RAD( angle );
+    float c = cosf( radians );
+    float s = sinf( radians );
+    
+    float u0 = (float)src->x / atlas_width;
+    float v0 = (float)src->y / atlas_height;
+    float u1 = (float)( src->x + src->w ) / atlas_width;
+    float v1 = (float)( src->y + src->h ) / atlas_height;
+    
+    const float corners[4][4] = {
+        // x,  y,  u,  v
+        { -hw, -hh, u0, v0 },
+        {  hw, -hh, u1, v0 },
+        {  hw,  hh, u1, v1 },
+        { -hw,  hh, u0, v1 },
     };
     
-    SDL_RenderCopyEx(renderer,
-                     sprites[type].texture,
-                     &src,
-                     &dst,
-                     angle,
-                     NULL,
-                     SDL_FLIP_NONE);
+    int first = sprite_vertices.count;
+    
+    for ( int i = 0; i < 4; i++ ) {
+        SDL_Vertex v;
+        v.position.x = cx + corners[i][0] * c - corners[i][1] * s;
+        v.position.y = cy + corners[i][0] * s + corners[i][1] * c;
+        v.color = (SDL_Color){ 255, 255, 255, 255 };
+        v.tex_coord.x = corners[i][2];
+        v.tex_coord.y = corners[i][3];
+        sprite_vertices.append( v );
+    }
+    
+    const int quad[6] = { 0, 1, 2, 0, 2, 3 };
+    for ( int i = 0; i < 6; i++ ) {
+        sprite_indices.append( first + quad[i] );
+    }
     
     // draw circle hitbox
 #if 0
-    int radius = src.w / 2;
+    int radius = src->w / 2;
     SDL_SetRenderDrawColor( renderer, 255, 0, 0, 255 );
-    vec2_t center = { (float)(x + src.w / 2), (float)(y + src.h / 2) };
+    vec2_t center = { (float)(x + src->w / 2), (float)(y + src->h / 2) };
     
-    for ( int y1 = y; y1 <= y + src.h; y1++ ) {
-        for ( int x1 = x; x1 <= x + src.w; x1++ ) {
+    for ( int y1 = y; y1 <= y + src->h; y1++ ) {
+        for ( int x1 = x; x1 <= x + src->w; x1++ ) {
             vec2_t v = { (float)x1, (float)y1 };
             vec2_t between = v - center;
             float dist = between.length();
@@ -97,8 +625,347 @@ void DrawSprite( int type, int x, int y, double angle, float scale ) {
 }
 
 
+/*
+ * Draw all queued sprites with a single draw call.
+ */
+void FlushSprites() {
+    if ( sprite_indices.count == 0 ) {
+        return;
+    }
+    
+    SDL_RenderGeometry( renderer,
+                        atlas,
+                        sprite_vertices.buffer,
+                        sprite_vertices.count,
+                        sprite_indices.buffer,
+                        sprite_indices.count );
+    
+    sprite_vertices.clear();
+    sprite_indices.clear();
+}
+
+
 void DrawPoint( int x, int y, paletteColor_t color ) {
+    if ( software.enabled ) {
+        PlotPoint( &software.fb, x, y, color );
+        return;
+    }
+    
     SDL_Color * c = &palette.colors[color];
     SDL_SetRenderDrawColor( renderer, c->r, c->g, c->b, 255 );
     SDL_RenderDrawPoint( renderer, x, y );
 }
+
+
+/*
+ * Queue a point to be drawn at the next FlushPoints. The software renderer
+ * plots it right away.
+ */
+void BatchPoint( int x, int y, paletteColor_t color ) {
+    if ( software.enabled ) {
+        PlotPoint( &software.fb, x, y, color );
+        return;
+    }
+    
+    point_batches[color].append( (SDL_Point){ x, y } );
+}
+
+
+/*
+ * Draw all batched points, with one draw call per color.
+ */
+void FlushPoints() {
+    for ( int i = 0; i < NUM_COLORS; i++ ) {
+        Array<SDL_Point> * batch = &point_batches[i];
+        
+        if ( batch->count == 0 ) {
+            continue;
+        }
+        
+        SDL_Color * c = &palette.colors[i];
+        SDL_SetRenderDrawColor( renderer, c->r, c->g, c->b, 255 );
+        SDL_RenderDrawPoints( renderer, batch->buffer, batch->count );
+        batch->clear();
+    }
+}
+
+
+void DrawEntity( entity_t * entity, float alpha ) {
+    
+    if ( entity->state == ES_RESPAWNING ) {
+        return;
+    }
+    
+    vec2_t position = EntityLerpPosition( entity, alpha );
+    
+    float r = EntityRadius( entity );
+    int x = position.x - r;
+    int y = position.y - r;
+    
+    double angle = RAD2DEG( EntityLerpRotation( entity, alpha ) ) + 90.0;
+    DrawSprite( (int)entity->type, x, y, angle, entity->scale );
+    
+    if ( EntityFlags( entity ) & FL_NO_WRAP ) {
+        return;
+    }
+    
+    int diameter = (int)(r * 2.0f);
+    
+    // if outside, draw twice horizontally
+    SDL_Rect horizontal_inner = {
+        .x = (int)r,
+        .y = 0,
+        .w = GAME_WIDTH - diameter,
+        .h = GAME_HEIGHT
+    };
+    
+    // if outside, draw twice vertically
+    SDL_Rect vertical_inner = {
+        .x = 0,
+        .y = (int)r,
+        .w = GAME_WIDTH,
+        .h = GAME_HEIGHT - diameter
+    };
+    
+    SDL_Point pt = Vec2ToSDL( position );
+    
+    if ( !SDL_PointInRect( &pt, &horizontal_inner ) ) {
+        int x2 = x;
+        
+        if ( position.x < r ) {
+            x2 += GAME_WIDTH;
+        }
+        
+        if ( position.x > GAME_WIDTH - r ) {
+            x2 -= GAME_WIDTH;
+        }
+        
+        DrawSprite( entity->type, x2, y, angle, entity->scale );
+    }
+    
+    if ( !SDL_PointInRect( &pt, &vertical_inner ) ) {
+        int y2 = y;
+        
+        if ( position.y < r ) {
+            y2 += GAME_HEIGHT;
+        }
+        
+        if ( position.y > GAME_HEIGHT - r ) {
+            y2 -= GAME_HEIGHT;
+        }
+        
+        DrawSprite( entity->type, x, y2, angle, entity->scale );
+    }
+}
+
+
+/*
+ * Split the stars into num_layers layers that scroll sideways, the nearest
+ * at speed pixels per second and the farthest standing still. One layer
+ * is a static starfield.
+ */
+void SetStarLayers( int num_layers, float speed ) {
+    starfield.num_layers = MAX( 1, MIN( num_layers, MAX_STAR_LAYERS ) );
+    starfield.speed = speed;
+    starfield.valid = false;
+}
+
+
+void InvalidateStarfield() {
+    starfield.valid = false;
+}
+
+
+static bool StarfieldIsCurrent() {
+    if ( !starfield.valid ) {
+        return false;
+    }
+    
+    int w, h;
+    SDL_RenderGetLogicalSize( renderer, &w, &h );
+    if ( w != starfield.width || h != starfield.height ) {
+        return false;
+    }
+    
+    return memcmp( &palette, &starfield.palette, sizeof palette ) == 0;
+}
+
+
+static bool BuildStarfield( world_t * world ) {
+    FreeStarfield();
+    
+    for ( int layer = 0; layer < starfield.num_layers; layer++ ) {
+        SDL_Texture * texture = SDL_CreateTexture( renderer,
+                                                   SDL_PIXELFORMAT_RGBA8888,
+                                                   SDL_TEXTUREACCESS_TARGET,
+                                                   GAME_WIDTH,
+                                                   GAME_HEIGHT );
+        if ( texture == NULL ) {
+            LOG_SDL_ERROR;
+            FreeStarfield();
+            return false;
+        }
+        
+        starfield.layers[layer] = texture;
+        SDL_SetTextureBlendMode( texture, SDL_BLENDMODE_BLEND );
+        SDL_SetRenderTarget( renderer, texture );
+        SDL_SetRenderDrawColor( renderer, 0, 0, 0, 0 );
+        SDL_RenderClear( renderer );
+        
+        for ( int i = layer; i < world->stars->count; i += starfield.num_layers ) {
+            star_t * s = &world->stars->buffer[i];
+            BatchPoint( s->x, s->y, s->color );
+        }
+        FlushPoints();
+    }
+    
+    SDL_SetRenderTarget( renderer, NULL );
+    
+    SDL_RenderGetLogicalSize( renderer, &starfield.width, &starfield.height );
+    starfield.palette = palette;
+    starfield.valid = true;
+    
+    return true;
+}
+
+
+// how far a parallax layer has scrolled left, in pixels
+static int StarLayerOffset( world_t * world, int layer ) {
+    game_t * game = world->game;
+    float time = game ? ( game->frame + game->alpha ) * game->tick_dt : 0.0f;
+    
+    // layer 0 is the farthest
+    float speed = 0.0f;
+    if ( starfield.num_layers > 1 ) {
+        speed = starfield.speed * layer / ( starfield.num_layers - 1 );
+    }
+    
+    return (int)fmodf( time * speed, GAME_WIDTH );
+}
+
+
+static void DrawStarsSoftware( world_t * world ) {
+    int offsets[MAX_STAR_LAYERS];
+    for ( int layer = 0; layer < starfield.num_layers; layer++ ) {
+        offsets[layer] = StarLayerOffset( world, layer );
+    }
+    
+    for ( int i = 0; i < world->stars->count; i++ ) {
+        star_t * s = &world->stars->buffer[i];
+        int x = (int)s->x - offsets[i % starfield.num_layers];
+        if ( x < 0 ) {
+            x += GAME_WIDTH;
+        }
+        
+        PlotPoint( &software.fb, x, (int)s->y, s->color );
+    }
+}
+
+
+static void DrawStars( world_t * world ) {
+    if ( software.enabled ) {
+        DrawStarsSoftware( world );
+        return;
+    }
+    
+    if ( !StarfieldIsCurrent() && !BuildStarfield( world ) ) {
+        // no render targets, draw them directly
+        for ( int i = 0; i < world->stars->count; i++ ) {
+            star_t * s = &world->stars->buffer[i];
+            BatchPoint( s->x, s->y, s->color );
+        }
+        FlushPoints();
+        return;
+    }
+    
+    for ( int layer = 0; layer < starfield.num_layers; layer++ ) {
+        SDL_Texture * texture = starfield.layers[layer];
+        int offset = StarLayerOffset( world, layer );
+        SDL_Rect dst = { -offset, 0, GAME_WIDTH, GAME_HEIGHT };
+        SDL_RenderCopy( renderer, texture, NULL, &dst );
+        
+        if ( offset != 0 ) {
+            dst.x += GAME_WIDTH;
+            SDL_RenderCopy( renderer, texture, NULL, &dst );
+        }
+    }
+}
+
+
+void DrawWorld( world_t * world, float alpha ) {
+    {
+        PROFILE_SCOPE( PHASE_DRAW_STARS );
+        DrawStars( world );
+    }
+    {
+        PROFILE_SCOPE( PHASE_DRAW_ENTITIES );
+        for ( int i = 0; i < world->entities.count; i++ ) {
+            entity_t * e = EntityAt( &world->entities, i );
+            DrawEntity( e, alpha );
+        }
+        FlushSprites();
+    }
+    {
+        PROFILE_SCOPE( PHASE_DRAW_PARTICLES );
+        particleSystem_t * ps = &world->particles;
+        for ( int i = 0; i < ps->count; i++ ) {
+            BatchPoint( ps->x[i], ps->y[i], (paletteColor_t)ps->color[i] );
+        }
+        FlushPoints();
+    }
+}
+
+
+/*
+ * Convert the software framebuffer to color and show it: one texture
+ * update and one copy per frame.
+ */
+static void PresentSoftware() {
+    PROFILE_SCOPE( PHASE_PRESENT );
+    
+    if ( software.texture == NULL ) {
+        ConvertFramebuffer( &software.fb, software.colors, software.rgb, GAME_WIDTH * sizeof(u32) );
+        return;
+    }
+    
+    void * pixels;
+    int pitch;
+    if ( SDL_LockTexture( software.texture, NULL, &pixels, &pitch ) != 0 ) {
+        LOG_SDL_ERROR;
+        return;
+    }
+    
+    ConvertFramebuffer( &software.fb, software.colors, (u32 *)pixels, pitch );
+    SDL_UnlockTexture( software.texture );
+    
+    SDL_RenderCopy( renderer, software.texture, NULL, NULL );
+    SDL_RenderPresent( renderer );
+}
+
+
+const framebuffer_t * SoftwareFramebuffer() {
+    return software.enabled ? &software.fb : NULL;
+}
+
+
+const u32 * SoftwareColors() {
+    return software.enabled ? software.colors : NULL;
+}
+
+
+void DrawGame( game_t * game ) {
+    if ( software.enabled ) {
+        ClearFramebuffer( &software.fb, COLOR_BLACK );
+        DrawWorld( game->world, game->alpha );
+        PresentSoftware();
+        return;
+    }
+    
+    SDL_SetRenderDrawColor( renderer, 0, 0, 0, 255 );
+    SDL_RenderClear( renderer );
+    
+    DrawWorld( game->world, game->alpha );
+    
+    PROFILE_SCOPE( PHASE_PRESENT );
+    SDL_RenderPresent( renderer );
+}
@@ -2,38 +2,39 @@
 #define draw_h
 
 #include <SDL2/SDL.h>
+#include "colors.h"
+#include "mylib.h"
 
-typedef enum
-{
-    COLOR_BLACK,
-    COLOR_BLUE,
-    COLOR_GREEN,
-    COLOR_CYAN,
-    COLOR_RED,
-    COLOR_MAGENTA,
-    COLOR_BROWN,
-    COLOR_WHITE,
-    COLOR_GRAY,
-    COLOR_BRIGHT_BLUE,
-    COLOR_BRIGHT_GREEN,
-    COLOR_BRIGHT_CYAN,
-    COLOR_BRIGHT_RED,
-    COLOR_BRIGHT_MAGENTA,
-    COLOR_YELLOW,
-    COLOR_BRIGHT_WHITE,
-    NUM_COLORS
-} paletteColor_t;
-
-typedef struct {
-    int count;
-    paletteColor_t array[16];
-} spriteColors_t;
+typedef struct entity entity_t;
+typedef struct world world_t;
+typedef struct game game_t;
+typedef struct framebuffer framebuffer_t;
 
 void InitWindow( void );
 void InitRenderer( void );
+void InitSoftwareRenderer( bool windowed );
 void ToggleFullscreen( void );
 void DrawSprite( int type, int x, int y, double angle, float scale );
+void FlushSprites( void );
+void SetRotationCache( int angle_steps, int scale_steps );
+#define ATLAS_WIDTH 512
+#define ROTATION_ATLAS_WIDTH 1024
+#define SPRITE_SCALE_STEPS 8 // sizes cached for sprites that grow in
+#define MAX_STAR_LAYERS 4
+#define STAR_PARALLAX_SPEED 8.0f // nearest layer, pixels per second
+
 void DrawPoint( int x, int y, paletteColor_t color );
+void BatchPoint( int x, int y, paletteColor_t color );
+void FlushPoints( void );
+void SetStarLayers( int num_layers, float speed );
+void InvalidateStarfield( void );
+void DrawEntity( entity_t * entity, float alpha );
+void DrawWorld( world_t * world, float alpha );
+void DrawGame( game_t * game );
+
+// the software renderer's last frame and its colors, NULL if not in use
+const framebuffer_t * SoftwareFramebuffer( void );
+const u32 * SoftwareColors( void );
 
 extern SDL_Window *     window;
 extern SDL_Renderer *   renderer;
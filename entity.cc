@@ -3,8 +3,7 @@
 #include "player.h"
 #include "world.h"
 #include "array.h"
-#include "draw.h"
-#include "utility.h"
+#include "mylib.h"
 
 #include <math.h>
 
@@ -20,13 +19,13 @@ static const spriteColors_t asteroid_colors = {
 };
 
 
-void BulletContact(entity_t * bullet, entity_t * hit);
+void BulletHitAsteroid( world_t * world, entity_t * bullet, entity_t * asteroid );
 
 
-const entity_t entity_defs[] = {
+const entityDef_t entity_defs[] = {
     [ENTITY_PLAYER] = {
-        .type = ENTITY_PLAYER,
         .radius = 4.0f,
+        .flags = FL_SCALES,
         .sprite_name = ASSET_DIR "/ship.px",
         .colors = {
             .count = 7,
@@ -40,33 +39,26 @@ const entity_t entity_defs[] = {
                 COLOR_BRIGHT_RED
             }
         },
-            .update = UpdatePlayer,
-            .contact = PlayerContact,
     },
     [ENTITY_ASTEROID_LARGE] = {
-        .type = ENTITY_ASTEROID_LARGE,
         .radius = 16.0f,
         .sprite_name = ASSET_DIR "/asteroid-large.px",
         .colors = asteroid_colors,
     },
     [ENTITY_ASTEROID_MEDIUM] = {
-        .type = ENTITY_ASTEROID_MEDIUM,
         .radius = 8.0f,
         .sprite_name = ASSET_DIR "/asteroid-medium.px",
         .colors = asteroid_colors,
     },
     [ENTITY_ASTEROID_SMALL] = {
-        .type = ENTITY_ASTEROID_SMALL,
         .radius = 4.0f,
         .sprite_name = ASSET_DIR "/asteroid-small.px",
         .colors = asteroid_colors,
     },
     [ENTITY_BULLET] = {
-        .type = ENTITY_BULLET,
         .radius = 1.5f,
+        .flags = FL_NO_WRAP | FL_SWEPT,
         .sprite_name = ASSET_DIR "/bullet.px",
-        .flags = FL_NO_WRAP,
-        .contact = BulletContact,
         .colors = {
             .count = 2,
             .array = {
@@ -78,29 +70,146 @@ const entity_t entity_defs[] = {
 };
 
 
+// run kernel over a group of entities, calling it directly
+template <void (* kernel)( world_t *, entity_t *, float )>
+static void UpdateGroup( world_t * world, entity_t ** entities, int count, float dt ) {
+    for ( int i = 0; i < count; i++ ) {
+        kernel( world, entities[i], dt );
+    }
+}
+
+
+// a handler for (b, a) contacts called as (a, b)
+template <contactHandler_t handler>
+static void Swapped( world_t * world, entity_t * a, entity_t * b ) {
+    handler( world, b, a );
+}
+
+
+const updateGroup_t entity_updates[NUM_ENTITY_TYPES] = {
+    [ENTITY_PLAYER]             = UpdateGroup<UpdatePlayer>,
+    [ENTITY_ASTEROID_LARGE]     = NULL,
+    [ENTITY_ASTEROID_MEDIUM]    = NULL,
+    [ENTITY_ASTEROID_SMALL]     = NULL,
+    [ENTITY_BULLET]             = NULL,
+};
+
+
+// rows and columns in entityType_t order: player, large, medium and small
+// asteroid, bullet
+const contactHandler_t entity_contacts[NUM_ENTITY_TYPES][NUM_ENTITY_TYPES] = {
+    [ENTITY_PLAYER] = {
+        NULL, PlayerHitAsteroid, PlayerHitAsteroid, PlayerHitAsteroid, NULL
+    },
+    [ENTITY_ASTEROID_LARGE] = {
+        Swapped<PlayerHitAsteroid>, NULL, NULL, NULL, Swapped<BulletHitAsteroid>
+    },
+    [ENTITY_ASTEROID_MEDIUM] = {
+        Swapped<PlayerHitAsteroid>, NULL, NULL, NULL, Swapped<BulletHitAsteroid>
+    },
+    [ENTITY_ASTEROID_SMALL] = {
+        Swapped<PlayerHitAsteroid>, NULL, NULL, NULL, Swapped<BulletHitAsteroid>
+    },
+    [ENTITY_BULLET] = {
+        NULL, BulletHitAsteroid, BulletHitAsteroid, BulletHitAsteroid, NULL
+    },
+};
+
+
 vec2_t EntityForward( entity_t * entity ) {
-    return (vec2_t){ cosf(entity->rotation), sinf(entity->rotation) };
+    vec2_t forward;
+    FastSinCos( entity->rotation, &forward.y, &forward.x );
+    
+    return forward;
+}
+
+
+// delta, or the other way around the screen's edges if that's shorter
+static vec2_t ShortWay( vec2_t delta ) {
+    if ( delta.x > GAME_WIDTH / 2 ) {
+        delta.x -= GAME_WIDTH;
+    } else if ( delta.x < -GAME_WIDTH / 2 ) {
+        delta.x += GAME_WIDTH;
+    }
+    
+    if ( delta.y > GAME_HEIGHT / 2 ) {
+        delta.y -= GAME_HEIGHT;
+    } else if ( delta.y < -GAME_HEIGHT / 2 ) {
+        delta.y += GAME_HEIGHT;
+    }
+    
+    return delta;
+}
+
+
+/*
+ * How far the entity moved in the last update. Takes the short way around
+ * if the entity wrapped.
+ */
+vec2_t EntityDisplacement( entity_t * entity ) {
+    vec2_t delta = entity->position - entity->prev_position;
+    
+    if ( EntityFlags( entity ) & FL_NO_WRAP ) {
+        return delta;
+    }
+    
+    return ShortWay( delta );
+}
+
+
+/*
+ * from - to, where from and to are positions of a and b. If either wraps,
+ * it's drawn again across the screen's edges, and the nearest copy counts.
+ */
+vec2_t EntityOffset( entity_t * a, entity_t * b, vec2_t from, vec2_t to ) {
+    vec2_t delta = from - to;
+    
+    if ( EntityFlags( a ) & EntityFlags( b ) & FL_NO_WRAP ) {
+        return delta;
+    }
+    
+    return ShortWay( delta );
+}
+
+
+/*
+ * Position between the previous and current update, alpha in [0, 1]. Takes
+ * the short way around if the entity wrapped.
+ */
+vec2_t EntityLerpPosition( entity_t * entity, float alpha ) {
+    vec2_t delta = EntityDisplacement( entity );
+    
+    if ( EntityFlags( entity ) & FL_NO_WRAP ) {
+        return entity->prev_position + delta * alpha;
+    }
+    
+    vec2_t lerp = entity->prev_position + delta * alpha;
+    lerp.x = fmodf( lerp.x + GAME_WIDTH, GAME_WIDTH );
+    lerp.y = fmodf( lerp.y + GAME_HEIGHT, GAME_HEIGHT );
+    
+    return lerp;
+}
+
+
+float EntityLerpRotation( entity_t * entity, float alpha ) {
+    float delta = entity->rotation - entity->prev_rotation;
+    return entity->prev_rotation + delta * alpha;
 }
 
 
 float EntityRadius( entity_t * e ) {
-    return e->radius * e->scale;
+    return entity_defs[e->type].radius * e->scale;
 }
 
 
 bool EntityIsVisible( entity_t * entity ) {
-    SDL_Point entity_point = Vec2ToSDL( entity->position );
+    int x = (int)entity->position.x;
+    int y = (int)entity->position.y;
     
     int diameter = EntityRadius( entity ) * 2.0f;
     
-    SDL_Rect visible_area = {
-        .x = -diameter,
-        .y = -diameter,
-        .w = GAME_WIDTH + diameter * 2,
-        .h = GAME_HEIGHT + diameter * 2
-    };
-    
-    return SDL_PointInRect( &entity_point, &visible_area );
+    return x >= -diameter && x < GAME_WIDTH + diameter
+        && y >= -diameter && y < GAME_HEIGHT + diameter;
 }
 
 
@@ -109,7 +218,7 @@ bool EntitiesAreColliding( entity_t * a, entity_t * b ) {
         return false;
     }
     
-    vec2_t between = a->position - b->position;
+    vec2_t between = EntityOffset( a, b, a->position, b->position );
     float ar = EntityRadius( a );
     float br = EntityRadius( b );
     float radii_sqruared = (ar + br) * (ar + br);
@@ -118,6 +227,67 @@ bool EntitiesAreColliding( entity_t * a, entity_t * b ) {
 }
 
 
+/*
+ * When in the last update a and b first touched, as a fraction of it in
+ * [0, 1], or -1 if they didn't or either isn't active. Entities without
+ * FL_SWEPT only count if they overlap at the end (time 1); with it, their
+ * paths through the update are tested too, so fast movers can't pass
+ * through each other between updates.
+ */
+float EntitiesTimeOfImpact( entity_t * a, entity_t * b ) {
+    if ( a->state != ES_ACTIVE || b->state != ES_ACTIVE ) {
+        return -1.0f;
+    }
+    
+    bool overlap = EntitiesAreColliding( a, b );
+    
+    if ( !( ( EntityFlags( a ) | EntityFlags( b ) ) & FL_SWEPT ) ) {
+        return overlap ? 1.0f : -1.0f;
+    }
+    
+    // b stands still, a moves relative to it
+    vec2_t offset = EntityOffset( a, b, a->prev_position, b->prev_position );
+    vec2_t motion = EntityDisplacement( a ) - EntityDisplacement( b );
+    float r = EntityRadius( a ) + EntityRadius( b );
+    
+    float t = SweepCircle( offset, motion, r, 1.0f );
+    if ( t < 0.0f && overlap ) {
+        t = 1.0f; // one wrapped around onto the other
+    }
+    
+    return t;
+}
+
+
+/*
+ * The earliest time in [0, max_time] at which a circle of the given radius,
+ * starting at offset from a point and moving at velocity, first covers the
+ * point. Returns 0 if it already does, -1 if it never does in time.
+ */
+float SweepCircle( vec2_t offset, vec2_t velocity, float radius, float max_time ) {
+    // solve |offset + velocity * t| = radius for the first t
+    float c = offset.lengthSquared() - radius * radius;
+    if ( c < 0.0f ) {
+        return 0.0f;
+    }
+    
+    float b = offset.x * velocity.x + offset.y * velocity.y;
+    if ( b >= 0.0f ) {
+        return -1.0f; // not moving toward it
+    }
+    
+    float a = velocity.lengthSquared();
+    float discriminant = b * b - a * c;
+    if ( discriminant < 0.0f ) {
+        return -1.0f; // passes by
+    }
+    
+    float t = ( -b - sqrtf( discriminant ) ) / a;
+    
+    return t <= max_time ? t : -1.0f;
+}
+
+
 void GeneralUpdateEntity( entity_t * entity, float dt ) {
 
     if ( entity->state != ES_ACTIVE ) {
@@ -129,7 +299,7 @@ void GeneralUpdateEntity( entity_t * entity, float dt ) {
     
     entity->rotation += entity->angular_speed * dt;
     
-    if ( !(entity->flags & FL_NO_WRAP) ) {
+    if ( !( EntityFlags( entity ) & FL_NO_WRAP ) ) {
         entity->position.x = fmodf(entity->position.x + GAME_WIDTH, GAME_WIDTH);
         entity->position.y = fmodf(entity->position.y + GAME_HEIGHT, GAME_HEIGHT);
     }
@@ -143,78 +313,20 @@ void GeneralUpdateEntity( entity_t * entity, float dt ) {
 }
 
 
-void UpdateEntity( entity_t * entity, float dt ) {
-    GeneralUpdateEntity( entity, dt );
+// everything but the type's update function
+void MoveEntity( entity_t * entity, float dt ) {
+    entity->prev_position = entity->position;
+    entity->prev_rotation = entity->rotation;
     
-    if ( entity->update ) {
-        entity->update(entity, dt);
-    }
+    GeneralUpdateEntity( entity, dt );
 }
 
 
-void DrawEntity( entity_t * entity ) {
+void UpdateEntity( world_t * world, entity_t * entity, float dt ) {
+    MoveEntity( entity, dt );
     
-    if ( entity->state == ES_RESPAWNING ) {
-        return;
-    }
-    
-    float r = EntityRadius( entity );
-    int x = entity->position.x - r;
-    int y = entity->position.y - r;
-    
-    double angle = RAD2DEG( entity->rotation ) + 90.0;
-    DrawSprite( (int)entity->type, x, y, angle, entity->scale );
-        
-    if ( entity->flags & FL_NO_WRAP ) {
-        return;
-    }
-    
-    int diameter = (int)(r * 2.0f);
-    
-    // if outside, draw twice horizontally
-    SDL_Rect horizontal_inner = {
-        .x = (int)r,
-        .y = 0,
-        .w = GAME_WIDTH - diameter,
-        .h = GAME_HEIGHT
-    };
-
-    // if outside, draw twice vertically
-    SDL_Rect vertical_inner = {
-        .x = 0,
-        .y = (int)r,
-        .w = GAME_WIDTH,
-        .h = GAME_HEIGHT - diameter
-    };
-    
-    SDL_Point pt = Vec2ToSDL( entity->position );
-    
-    if ( !SDL_PointInRect( &pt, &horizontal_inner ) ) {
-        int x2 = x;
-        
-        if ( entity->position.x < r ) {
-            x2 += GAME_WIDTH;
-        }
-        
-        if ( entity->position.x > GAME_WIDTH - r ) {
-            x2 -= GAME_WIDTH;
-        }
-
-        DrawSprite( entity->type, x2, y, angle, entity->scale );
-    }
-    
-    if ( !SDL_PointInRect( &pt, &vertical_inner ) ) {
-        int y2 = y;
-        
-        if ( entity->position.y < r ) {
-            y2 += GAME_HEIGHT;
-        }
-        
-        if ( entity->position.y > GAME_HEIGHT - r ) {
-            y2 -= GAME_HEIGHT;
-        }
-        
-        DrawSprite( entity->type, x, y2, angle, entity->scale );
+    if ( entity_updates[entity->type] ) {
+        entity_updates[entity->type]( world, &entity, 1, dt );
     }
 }
 
@@ -225,35 +337,58 @@ int EntityArea( entity_t * entity ) {
 }
 
 
-void ExplodeEntity( entity_t * entity ) {
+#define DEBRIS_BATCH 64 // particles' worth of random numbers drawn at once
+
+
+void ExplodeEntity( world_t * world, entity_t * entity ) {
     
+    rng_t * rng = WorldRng( world );
+    const spriteColors_t * colors = &entity_defs[entity->type].colors;
     int num_particles = EntityArea( entity ) / 2;
     Array<particle_t> debris( num_particles );
+    float r = EntityRadius( entity );
     
-    for ( int i = 0; i < num_particles; i++ ) {
-        particle_t p;
+    for ( int start = 0; start < num_particles; start += DEBRIS_BATCH ) {
+        int n = MIN( num_particles - start, DEBRIS_BATCH );
         
-        float r = EntityRadius( entity );
-        p.position = (vec2_t){ 0.0f, RandomFloat( -r, 0.0f ) };
-        p.position = p.position.rotated( RANDOM_ANGLE );
-        p.position += entity->position;
-                
-        p.velocity = (vec2_t){ 1.0f, 0.0f };
-        p.velocity = p.velocity.rotated( RANDOM_ANGLE );
-        p.velocity *= RandomFloat( 15.0f, 40.0f );
-        p.velocity += entity->velocity;
+        float distances[DEBRIS_BATCH];
+        float speeds[DEBRIS_BATCH];
+        float lifespans[DEBRIS_BATCH];
+        float angles[DEBRIS_BATCH * 2];
+        RngFloats( rng, distances, n, -r, 0.0f );
+        RngFloats( rng, speeds, n, 15.0f, 40.0f );
+        RngFloats( rng, lifespans, n, 0.25f, 1.0f );
+        RngAngles( rng, angles, n * 2 );
         
-        p.color = entity->colors.array[Random( 0, entity->colors.count )];
-        p.lifespan = Random(FPS * 0.25, FPS * 1);
+        // scatter each particle about the center and send it off in its
+        // own direction, a batch at a time
+        vec2_t offsets[DEBRIS_BATCH];
+        vec2_t velocities[DEBRIS_BATCH];
+        for ( int i = 0; i < n; i++ ) {
+            offsets[i] = (vec2_t){ 0.0f, distances[i] };
+            velocities[i] = (vec2_t){ speeds[i], 0.0f };
+        }
+        RotateVectors( offsets, offsets, angles, n );
+        RotateVectors( velocities, velocities, angles + n, n );
         
-        debris.append( p );
+        for ( int i = 0; i < n; i++ ) {
+            particle_t p;
+            
+            p.position = offsets[i] + entity->position;
+            p.velocity = velocities[i] + entity->velocity;
+            
+            p.color = colors->array[RngInt( rng, 0, colors->count )];
+            p.lifespan = lifespans[i];
+            
+            debris.append( p );
+        }
     }
     
-    SpawnParticles( entity->world, debris.buffer, debris.count );
+    SpawnParticles( world, debris.buffer, debris.count );
 }
     
 
-void DestroyAsteroid( entity_t * asteroid ) {
+void DestroyAsteroid( world_t * world, entity_t * asteroid ) {
     asteroid->state = ES_REMOVE;
     
     if ( asteroid->type == ENTITY_ASTEROID_SMALL ) {
@@ -267,31 +402,26 @@ void DestroyAsteroid( entity_t * asteroid ) {
         new_type = ENTITY_ASTEROID_SMALL;
     }
     
+    rng_t * rng = WorldRng( world );
+    
     for ( int i = 0; i < 2; i++ ) {
         vec2_t pt = { 0, EntityRadius( asteroid ) };
-        pt = pt.rotated( RANDOM_ANGLE );
+        pt = pt.rotated( RngAngle( rng ) );
         pt += asteroid->position;
         
-        entity_t * a = SpawnEntity( asteroid->world, new_type, pt, RANDOM_ANGLE );
-        a->angular_speed = asteroid->angular_speed;
-        a->angular_speed *= RandomFloat( 2.0f, 4.0f );
-        a->velocity = asteroid->velocity * RandomFloat( 1.5f, 2.0f );
-        a->rotation += RandomFloat( M_PI / 4.0, -M_PI / 4.0);
-        a->velocity = a->velocity.rotated( RandomFloat( -45.0f, 45.0f ) );
+        entity_t a = MakeEntity( new_type, pt, RngAngle( rng ) );
+        a.angular_speed = asteroid->angular_speed;
+        a.angular_speed *= RngFloat( rng, 2.0f, 4.0f );
+        a.velocity = asteroid->velocity * RngFloat( rng, 1.5f, 2.0f );
+        a.rotation += RngFloat( rng, M_PI / 4.0, -M_PI / 4.0);
+        a.velocity = a.velocity.rotated( RngFloat( rng, -M_PI / 4.0, M_PI / 4.0 ) );
+        DeferSpawn( world, &a );
     }
 }
 
 
-void BulletContact( entity_t * bullet, entity_t * hit ) {
-    switch ( hit->type ) {
-        case ENTITY_ASTEROID_LARGE:
-        case ENTITY_ASTEROID_MEDIUM:
-        case ENTITY_ASTEROID_SMALL:
-            bullet->state = ES_REMOVE;
-            DestroyAsteroid( hit );
-            ExplodeEntity( hit );
-            break;
-        default:
-            break;
-    }
+void BulletHitAsteroid( world_t * world, entity_t * bullet, entity_t * asteroid ) {
+    bullet->state = ES_REMOVE;
+    DestroyAsteroid( world, asteroid );
+    ExplodeEntity( world, asteroid );
 }
@@ -2,8 +2,8 @@
 #define entity_h
 
 #include "vec2.h"
-#include "draw.h"
-#include "sprite.h"
+#include "colors.h"
+#include "mylib.h"
 
 typedef enum entity_type
 {
@@ -24,12 +24,20 @@ typedef enum {
 } entityState_t;
 
 #define FL_NO_WRAP  0x01
+#define FL_SCALES   0x02 // drawn smaller than full size, e.g. while appearing
+#define FL_SWEPT    0x04 // collides anywhere along its path through the tick
 
 typedef struct {
-    int shot_timer; // shot cooldown
-    int respawn_frame; // if ES_RESPAWING, respawn at the this frame
+    float shot_timer; // shot cooldown, in seconds
+    float exhaust; // particles owed, carried over to the next tick
 } playerInfo_t;
 
+// refers to an entity for as long as it exists; see entitypool.h
+typedef struct {
+    u32 index;
+    u32 generation;
+} entityHandle_t;
+
 typedef struct world world_t;
 typedef struct entity entity_t;
 
@@ -39,41 +47,75 @@ typedef struct entity entity_t;
 //    void (* contact)(entity_t * self, entity_t * hit);
 //} entityState_t;
 
+// what every entity of a type shares; see entity_defs
+typedef struct {
+    float           radius; // at full scale, use EntityRadius() to read
+    int             flags;
+    const char *    sprite_name;
+    spriteColors_t  colors;
+} entityDef_t;
+
+/*
+ * Only what differs between entities of a type, which is all an update
+ * touches. It fills one 64 byte cache line, and the entity pool keeps
+ * entities packed and aligned, so a pass over them loads nothing else.
+ */
 struct entity {
+    entityHandle_t  handle;
     entityType_t    type;
-//    entityState_t * state;
     entityState_t   state;
         
     vec2_t          position;
     vec2_t          velocity;
     float           rotation; // in radians
     float           angular_speed;
-    float           radius; // use EntityRadius() to read
+    vec2_t          prev_position; // as of the previous update, for drawing
+    float           prev_rotation;
     float           scale;
-
-    int             flags;
-    
-    const char *    sprite_name;
-    spriteColors_t  colors;
-    world_t *       world;
     
     union {
         playerInfo_t  player;
     } info;
-    
-    void (* update)(entity_t * self, float dt);
-    void (* contact)(entity_t * self, entity_t * hit);
-    void (* draw)(entity * self);
 };
 
-extern const entity_t entity_defs[];
+static_assert( sizeof(entity_t) <= 64, "entity_t no longer fits a cache line" );
+
+extern const entityDef_t entity_defs[];
+
+static inline int EntityFlags( const entity_t * e ) {
+    return entity_defs[e->type].flags;
+}
+
+/*
+ * What a type does beyond moving is looked up by type, not carried by each
+ * entity. A type's update runs over a group of entities all of that type,
+ * so the loop calls one known function. A contact between types a and b
+ * is handled by entity_contacts[a][b], called with an entity of type a
+ * first; NULL if the pair doesn't interact, in which case it's not even
+ * tested.
+ */
+typedef void (* updateGroup_t)( world_t * world, entity_t ** entities, int count, float dt );
+typedef void (* contactHandler_t)( world_t * world, entity_t * a, entity_t * b );
+
+extern const updateGroup_t entity_updates[NUM_ENTITY_TYPES]; // NULL if none
+extern const contactHandler_t entity_contacts[NUM_ENTITY_TYPES][NUM_ENTITY_TYPES];
+
+static inline contactHandler_t ContactHandler( const entity_t * a, const entity_t * b ) {
+    return entity_contacts[a->type][b->type];
+}
 
 float   EntityRadius( entity_t * e );
 void    GeneralUpdateEntity( entity_t * entity, float dt );
-void    UpdateEntity(entity_t *, float dt);
-void    DrawEntity(entity_t *);
+void    MoveEntity( entity_t * entity, float dt );
+void    UpdateEntity( world_t * world, entity_t * entity, float dt );
 vec2_t  EntityForward( entity_t * entity );
-void    ExplodeEntity( entity_t * entity );
+vec2_t  EntityLerpPosition( entity_t * entity, float alpha );
+float   EntityLerpRotation( entity_t * entity, float alpha );
+void    ExplodeEntity( world_t * world, entity_t * entity );
 bool    EntitiesAreColliding( entity_t * a, entity_t * b );
+float   EntitiesTimeOfImpact( entity_t * a, entity_t * b );
+vec2_t  EntityDisplacement( entity_t * entity );
+vec2_t  EntityOffset( entity_t * a, entity_t * b, vec2_t from, vec2_t to );
+float   SweepCircle( vec2_t offset, vec2_t velocity, float radius, float max_time );
 
 #endif /* entity_h */
@@ -0,0 +1,145 @@
+#include "entitypool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void * Realloc( void * buffer, size_t size ) {
+    buffer = realloc( buffer, size );
+    if ( buffer == NULL ) {
+        fprintf( stderr, "%s: realloc failed\n", __func__ );
+        exit( EXIT_FAILURE );
+    }
+    
+    return buffer;
+}
+
+
+void InitEntityPool( entityPool_t * pool ) {
+    memset( pool, 0, sizeof *pool );
+    pool->free_head = -1;
+}
+
+
+void FreeEntityPool( entityPool_t * pool ) {
+    for ( int i = 0; i < pool->num_blocks; i++ ) {
+        free( pool->blocks[i] );
+    }
+    
+    free( pool->blocks );
+    free( pool->live );
+    InitEntityPool( pool );
+}
+
+
+/*
+ * Remove every entity, keeping the memory. Outstanding handles all go
+ * stale.
+ */
+void ClearEntityPool( entityPool_t * pool ) {
+    for ( int i = 0; i < pool->count; i++ ) {
+        EntityAt( pool, i )->state = ES_REMOVE;
+    }
+    
+    RemoveEntities( pool );
+}
+
+
+static entityBlock_t * AllocBlock( void ) {
+    void * block;
+    if ( posix_memalign( &block, 64, sizeof(entityBlock_t) ) != 0 ) {
+        fprintf( stderr, "%s: posix_memalign failed\n", __func__ );
+        exit( EXIT_FAILURE );
+    }
+    
+    return (entityBlock_t *)block;
+}
+
+
+// a slot's generation and free list link
+#define BLOCK_OF( pool, index ) ( (pool)->blocks[(index) / ENTITY_BLOCK_SIZE] )
+#define GENERATION( pool, index ) \
+    ( BLOCK_OF( pool, index )->generations[(index) % ENTITY_BLOCK_SIZE] )
+#define NEXT_FREE( pool, index ) \
+    ( BLOCK_OF( pool, index )->next_free[(index) % ENTITY_BLOCK_SIZE] )
+
+static int AllocSlot( entityPool_t * pool ) {
+    if ( pool->free_head != -1 ) {
+        int index = pool->free_head;
+        pool->free_head = NEXT_FREE( pool, index );
+        return index;
+    }
+    
+    if ( pool->num_slots == pool->num_blocks * ENTITY_BLOCK_SIZE ) {
+        size_t size = ( pool->num_blocks + 1 ) * sizeof *pool->blocks;
+        pool->blocks = (entityBlock_t **)Realloc( pool->blocks, size );
+        pool->blocks[pool->num_blocks++] = AllocBlock();
+    }
+    
+    int index = pool->num_slots++;
+    GENERATION( pool, index ) = 1; // 0 is never valid
+    
+    return index;
+}
+
+
+/*
+ * Copy entity into a free slot and return it, with its handle set.
+ */
+entity_t * AddEntity( entityPool_t * pool, const entity_t * entity ) {
+    int index = AllocSlot( pool );
+    entity_t * slot = EntityInSlot( pool, index );
+    
+    if ( pool->count == pool->live_capacity ) {
+        pool->live_capacity = pool->live_capacity ? pool->live_capacity * 2 : 64;
+        pool->live = (int *)Realloc( pool->live, pool->live_capacity * sizeof(int) );
+    }
+    pool->live[pool->count++] = index;
+    
+    *slot = *entity;
+    slot->handle = (entityHandle_t){ (u32)index, GENERATION( pool, index ) };
+    
+    return slot;
+}
+
+
+/*
+ * Returns NULL if the entity the handle refers to has been removed.
+ */
+entity_t * GetEntity( const entityPool_t * pool, entityHandle_t handle ) {
+    if ( handle.index >= (u32)pool->num_slots ) {
+        return NULL;
+    }
+    
+    if ( GENERATION( pool, handle.index ) != handle.generation ) {
+        return NULL;
+    }
+    
+    return EntityInSlot( pool, handle.index );
+}
+
+
+/*
+ * Free the slots of all entities marked ES_REMOVE, keeping the rest in
+ * order.
+ */
+void RemoveEntities( entityPool_t * pool ) {
+    int out = 0;
+    
+    for ( int i = 0; i < pool->count; i++ ) {
+        int index = pool->live[i];
+        
+        if ( EntityInSlot( pool, index )->state != ES_REMOVE ) {
+            pool->live[out++] = index;
+            continue;
+        }
+        
+        if ( ++GENERATION( pool, index ) == 0 ) {
+            GENERATION( pool, index ) = 1;
+        }
+        NEXT_FREE( pool, index ) = pool->free_head;
+        pool->free_head = index;
+    }
+    
+    pool->count = out;
+}
@@ -0,0 +1,58 @@
+#ifndef entitypool_h
+#define entitypool_h
+
+/*
+ * Entities live in fixed blocks of slots that never move, so an entity_t *
+ * stays valid until the entity is removed. Removed slots go on a free list
+ * and are reused, each time with a new generation, so a handle kept past
+ * its entity's removal can be told apart from the slot's new occupant.
+ *
+ * Live entities are also listed in spawn order, which is the order they
+ * are visited in. Removing one doesn't reorder the rest, and entities
+ * spawned during a pass over [0, count) are added after count.
+ */
+
+#include "entity.h"
+#include "mylib.h"
+
+#define ENTITY_BLOCK_SIZE 256 // slots per block
+
+// Entities are kept apart from the slot bookkeeping, so they're packed one
+// per cache line (the block is cache line aligned) for passes over them.
+typedef struct
+{
+    entity_t        entities[ENTITY_BLOCK_SIZE];
+    u32             generations[ENTITY_BLOCK_SIZE]; // bumped each time the slot is freed
+    int             next_free[ENTITY_BLOCK_SIZE]; // if on the free list
+} entityBlock_t;
+
+typedef struct
+{
+    entityBlock_t **blocks;
+    int             num_blocks;
+    int             num_slots; // slots handed out so far, free or not
+    int             free_head; // -1 if empty
+    
+    int *           live; // slot indices of live entities, in spawn order
+    int             count;
+    int             live_capacity;
+} entityPool_t;
+
+void        InitEntityPool( entityPool_t * pool );
+void        FreeEntityPool( entityPool_t * pool );
+void        ClearEntityPool( entityPool_t * pool );
+
+entity_t *  AddEntity( entityPool_t * pool, const entity_t * entity );
+entity_t *  GetEntity( const entityPool_t * pool, entityHandle_t handle );
+void        RemoveEntities( entityPool_t * pool );
+
+static inline entity_t * EntityInSlot( const entityPool_t * pool, int index ) {
+    return &pool->blocks[index / ENTITY_BLOCK_SIZE]->entities[index % ENTITY_BLOCK_SIZE];
+}
+
+// the i-th live entity, in spawn order
+static inline entity_t * EntityAt( const entityPool_t * pool, int i ) {
+    return EntityInSlot( pool, pool->live[i] );
+}
+
+#endif /* entitypool_h */
@@ -0,0 +1,98 @@
+#include "fastmath.h"
+#include "vec2.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+/*
+ * FastSinCos of four angles, with the same operations in the same order,
+ * so each lane gets exactly what the scalar version would.
+ */
+static inline void FastSinCos4( __m128 radians, __m128 * s, __m128 * c ) {
+    const __m128 round = _mm_set1_ps( FM_ROUND );
+    
+    __m128 q = _mm_sub_ps( _mm_add_ps( _mm_mul_ps( radians, _mm_set1_ps( FM_2_OVER_PI ) ),
+                                       round ),
+                           round );
+    __m128 r = _mm_sub_ps( radians, _mm_mul_ps( q, _mm_set1_ps( FM_PI_2_A ) ) );
+    r = _mm_sub_ps( r, _mm_mul_ps( q, _mm_set1_ps( FM_PI_2_B ) ) );
+    r = _mm_sub_ps( r, _mm_mul_ps( q, _mm_set1_ps( FM_PI_2_C ) ) );
+    __m128 r2 = _mm_mul_ps( r, r );
+    
+    __m128 ps = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( FM_SIN_3 ), r2 ), _mm_set1_ps( FM_SIN_2 ) );
+    ps = _mm_add_ps( _mm_mul_ps( ps, r2 ), _mm_set1_ps( FM_SIN_1 ) );
+    ps = _mm_add_ps( _mm_mul_ps( _mm_mul_ps( ps, r2 ), r ), r );
+    
+    __m128 pc = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( FM_COS_3 ), r2 ), _mm_set1_ps( FM_COS_2 ) );
+    pc = _mm_add_ps( _mm_mul_ps( pc, r2 ), _mm_set1_ps( FM_COS_1 ) );
+    pc = _mm_mul_ps( _mm_mul_ps( pc, r2 ), r2 );
+    pc = _mm_add_ps( _mm_sub_ps( pc, _mm_mul_ps( _mm_set1_ps( 0.5f ), r2 ) ), _mm_set1_ps( 1.0f ) );
+    
+    // q is a whole number, so truncating is exact
+    __m128i quadrant = _mm_cvttps_epi32( q );
+    const __m128i one = _mm_set1_epi32( 1 );
+    const __m128i two = _mm_set1_epi32( 2 );
+    
+    __m128 swap = _mm_castsi128_ps( _mm_cmpeq_epi32( _mm_and_si128( quadrant, one ), one ) );
+    __m128 sin_sign = _mm_castsi128_ps( _mm_slli_epi32( _mm_and_si128( quadrant, two ), 30 ) );
+    __m128 cos_sign = _mm_castsi128_ps(
+        _mm_slli_epi32( _mm_and_si128( _mm_add_epi32( quadrant, one ), two ), 30 ) );
+    
+    __m128 sin_value = _mm_or_ps( _mm_and_ps( swap, pc ), _mm_andnot_ps( swap, ps ) );
+    __m128 cos_value = _mm_or_ps( _mm_and_ps( swap, ps ), _mm_andnot_ps( swap, pc ) );
+    
+    *s = _mm_xor_ps( sin_value, sin_sign );
+    *c = _mm_xor_ps( cos_value, cos_sign );
+}
+#endif
+
+
+void FastSinCosArray( float * s, float * c, const float * radians, int count ) {
+    int i = 0;
+    
+#ifdef __SSE2__
+    for ( ; i + 4 <= count; i += 4 ) {
+        __m128 s4, c4;
+        FastSinCos4( _mm_loadu_ps( radians + i ), &s4, &c4 );
+        _mm_storeu_ps( s + i, s4 );
+        _mm_storeu_ps( c + i, c4 );
+    }
+#endif
+    
+    for ( ; i < count; i++ ) {
+        FastSinCos( radians[i], &s[i], &c[i] );
+    }
+}
+
+
+void RotateVectors
+ (  vec2_t * out,
+    const vec2_t * in,
+    const float * radians,
+    int count )
+{
+    int i = 0;
+    
+#ifdef __SSE2__
+    for ( ; i + 4 <= count; i += 4 ) {
+        __m128 s, c;
+        FastSinCos4( _mm_loadu_ps( radians + i ), &s, &c );
+        
+        // x0 y0 x1 y1, x2 y2 x3 y3 -> x0 x1 x2 x3, y0 y1 y2 y3
+        __m128 lo = _mm_loadu_ps( &in[i].x );
+        __m128 hi = _mm_loadu_ps( &in[i + 2].x );
+        __m128 x = _mm_shuffle_ps( lo, hi, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+        __m128 y = _mm_shuffle_ps( lo, hi, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+        
+        __m128 rx = _mm_sub_ps( _mm_mul_ps( c, x ), _mm_mul_ps( s, y ) );
+        __m128 ry = _mm_add_ps( _mm_mul_ps( s, x ), _mm_mul_ps( c, y ) );
+        
+        _mm_storeu_ps( &out[i].x, _mm_unpacklo_ps( rx, ry ) );
+        _mm_storeu_ps( &out[i + 2].x, _mm_unpackhi_ps( rx, ry ) );
+    }
+#endif
+    
+    for ( ; i < count; i++ ) {
+        out[i] = in[i].rotated( radians[i] );
+    }
+}
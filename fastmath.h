@@ -0,0 +1,92 @@
+#ifndef fastmath_h
+#define fastmath_h
+
+/*
+ * Sine and cosine for the simulation. All angles are in radians.
+ *
+ * SinCos is libm's, both from one call. FastSinCos is a polynomial
+ * approximation: the angle is reduced to [-pi/4, pi/4] by its nearest
+ * quarter turn, in three parts so the reduction stays exact, and sine and
+ * cosine are minimax polynomials (Cephes' sinf and cosf) on what's left.
+ *
+ * For |radians| <= 8192, FastSinCos is within 1e-7 of the true values
+ * (about 1 ulp at 1.0). Past that the reduction starts losing bits: the
+ * error is about 1e-6 at 1e5 and 3e-2 at 1e6. Keep angles small, e.g. an
+ * entity's rotation, which would take hours of spinning to get there.
+ *
+ * It's only float adds and multiplies, no libm, so results are the same
+ * on every machine and in the SIMD batch versions, which matters for
+ * replays.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+struct vec2_t;
+
+#define FM_2_OVER_PI    0.636619772367581343f
+#define FM_PI_2_A       1.5703125f // pi / 2 = A + B + C
+#define FM_PI_2_B       4.837512969970703125e-4f
+#define FM_PI_2_C       7.54978995489188216e-8f
+#define FM_ROUND        12582912.0f // 1.5 * 2^23: x + FM_ROUND - FM_ROUND rounds x
+
+#define FM_SIN_1        -1.6666654611e-1f
+#define FM_SIN_2        8.3321608736e-3f
+#define FM_SIN_3        -1.9515295891e-4f
+#define FM_COS_1        4.166664568298827e-2f
+#define FM_COS_2        -1.388731625493765e-3f
+#define FM_COS_3        2.443315711809948e-5f
+
+static inline uint32_t FloatBits( float f ) {
+    uint32_t bits;
+    memcpy( &bits, &f, sizeof bits );
+    return bits;
+}
+
+
+static inline float BitsFloat( uint32_t bits ) {
+    float f;
+    memcpy( &f, &bits, sizeof f );
+    return f;
+}
+
+
+static inline void SinCos( float radians, float * s, float * c ) {
+    // compilers turn the pair into a single sincosf
+    *s = sinf( radians );
+    *c = cosf( radians );
+}
+
+
+static inline void FastSinCos( float radians, float * s, float * c ) {
+    float q = ( radians * FM_2_OVER_PI + FM_ROUND ) - FM_ROUND;
+    float r = ( ( radians - q * FM_PI_2_A ) - q * FM_PI_2_B ) - q * FM_PI_2_C;
+    float r2 = r * r;
+    
+    float ps = ( ( FM_SIN_3 * r2 + FM_SIN_2 ) * r2 + FM_SIN_1 ) * r2 * r + r;
+    float pc = ( ( FM_COS_3 * r2 + FM_COS_2 ) * r2 + FM_COS_1 ) * r2 * r2
+             - 0.5f * r2 + 1.0f;
+    
+    // fix up for the quadrant with bit masks: the quadrant of a random
+    // angle is random, and branches on it would mispredict half the time
+    uint32_t quadrant = (uint32_t)(int32_t)q;
+    uint32_t swap = 0 - ( quadrant & 1 );
+    uint32_t bits_s = FloatBits( ps );
+    uint32_t bits_c = FloatBits( pc );
+    
+    *s = BitsFloat( ( ( bits_c & swap ) | ( bits_s & ~swap ) ) ^ ( ( quadrant & 2 ) << 30 ) );
+    *c = BitsFloat( ( ( bits_s & swap ) | ( bits_c & ~swap ) ) ^ ( ( ( quadrant + 1 ) & 2 ) << 30 ) );
+}
+
+// FastSinCos of count angles
+void    FastSinCosArray( float * s, float * c, const float * radians, int count );
+
+// out[i] = in[i] rotated radians[i], with FastSinCos; out may be in
+void    RotateVectors
+ (  struct vec2_t * out,
+    const struct vec2_t * in,
+    const float * radians,
+    int count );
+
+#endif /* fastmath_h */
@@ -1,6 +1,8 @@
 #include "game.h"
-#include "draw.h"
 #include "world.h"
+#include "mylib.h"
+#include "profile.h"
+#include "replay.h"
 
 #include <stdlib.h>
 
@@ -12,6 +14,8 @@ game_t * InitGame() {
     }
     
     game->level = 1;
+    game->max_ticks = MAX_TICKS_PER_FRAME;
+    SetTickRate( game, FPS );
     game->world = InitWorld(game);
         
     return game;
@@ -29,18 +33,20 @@ void StartLevel( game_t * game, int number ) {
     
     // spawn asteroids
     
+    rng_t * rng = WorldRng( game->world );
+    
     int num_asteroids = 20; // TODO: temp
     for ( int i = 0; i < num_asteroids; i++ ) {
         
         vec2_t pt;
-        if ( Random( 0, 2 ) == 0 ) {
+        if ( RngInt( rng, 0, 2 ) == 0 ) {
             // spawn it anywhere along the sides
-            pt.x = Random( 0, 2 ) == 0 ? 1.0f : (float)( GAME_WIDTH - 1 );
-            pt.y = Random( 0, GAME_HEIGHT );
+            pt.x = RngInt( rng, 0, 2 ) == 0 ? 1.0f : (float)( GAME_WIDTH - 1 );
+            pt.y = RngInt( rng, 0, GAME_HEIGHT );
         } else {
             // spawn it anywhere along the top and bottom
-            pt.x = Random( 0, GAME_WIDTH );
-            pt.y = Random( 0, 2 ) == 0 ? 1.0f : (float)( GAME_HEIGHT - 1 );
+            pt.x = RngInt( rng, 0, GAME_WIDTH );
+            pt.y = RngInt( rng, 0, 2 ) == 0 ? 1.0f : (float)( GAME_HEIGHT - 1 );
         }
         
         entity_t * asteroid = SpawnEntity(game->world,
@@ -49,51 +55,59 @@ void StartLevel( game_t * game, int number ) {
                                           0.0f);
         
         // random angle
-        asteroid->rotation = RandomFloat( 0, MAX_ANGLE );
+        asteroid->rotation = RngFloat( rng, 0, MAX_ANGLE );
+        asteroid->prev_rotation = asteroid->rotation;
         
         // start it moving
-        asteroid->velocity = EntityForward(asteroid) * RandomFloat(7.0f, 13.0f);
+        asteroid->velocity = EntityForward(asteroid) * RngFloat( rng, 7.0f, 13.0f );
         
         // random rotational velocity
         float spread = DEG2RAD(60);
-        asteroid->angular_speed = RandomFloat( -spread, spread );
+        asteroid->angular_speed = RngFloat( rng, -spread, spread );
     }
 }
 
 
-void DrawGame( game_t * game ) {
-    SDL_SetRenderDrawColor( renderer, 0, 0, 0, 255 );
-    SDL_RenderClear( renderer );
-    
-    DrawWorld( game->world );
+void UpdateGame( game_t * game, float dt ) {
+    PROFILE_TICK();
+    UpdateWorld( game->world, dt );
+    ++game->frame;
     
-    SDL_RenderPresent( renderer );
+    if ( game->recording ) {
+        RecordTick( game->recording, game->world );
+    }
 }
 
 
-void DoFrame( game_t * game, float dt ) {
-    SDL_Event event;
+void SetTickRate( game_t * game, float ticks_per_second ) {
+    game->tick_rate = ticks_per_second;
+    game->tick_dt = 1.0f / ticks_per_second;
+    game->accumulator = 0.0f;
+}
+
+
+/*
+ * Run as many fixed ticks as fit in the real time elapsed since the last
+ * call, plus whatever was left over. If the simulation falls more than
+ * max_ticks behind, the backlog is dropped rather than trying to catch up.
+ * Returns the number of ticks run.
+ */
+int AdvanceGame( game_t * game, float elapsed ) {
+    game->accumulator += elapsed;
     
-    while ( SDL_PollEvent( &event ) ) {
-        switch ( event.type ) {
-            case SDL_QUIT:
-                exit(EXIT_SUCCESS);
-                break;
-            case SDL_KEYDOWN:
-                switch ( event.key.keysym.sym ) {
-                    case SDLK_BACKSLASH:
-                        ToggleFullscreen();
-                        break;
-                    default:
-                        break;
-                }
-            default:
-                break;
+    int ticks = 0;
+    while ( game->accumulator >= game->tick_dt ) {
+        if ( ticks == game->max_ticks ) {
+            game->accumulator = 0.0f;
+            break;
         }
+        
+        UpdateGame( game, game->tick_dt );
+        game->accumulator -= game->tick_dt;
+        ++ticks;
     }
     
-    UpdateWorld( game->world, dt );
-    DrawGame( game );
+    game->alpha = game->accumulator / game->tick_dt;
     
-    ++game->frame;
+    return ticks;
 }
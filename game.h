@@ -1,26 +1,37 @@
 #ifndef GAME_H
 #define GAME_H
 
-#include "sprite.h"
 #include "defines.h"
 
 #define MAX_ENTITIES 200
+#define MAX_TICKS_PER_FRAME 8 // default catch-up limit
 
 typedef struct world world_t;
+typedef struct replay replay_t;
 
 
 typedef struct game
 {
-    int         frame;
+    int         frame; // number of simulation ticks run
     world_t *   world;
     int         level;
+    
+    // fixed timestep
+    float       tick_rate; // ticks per second
+    float       tick_dt;
+    float       accumulator; // real time not yet simulated
+    int         max_ticks; // per AdvanceGame, the rest is dropped
+    float       alpha; // how far between the last two ticks to draw
+    
+    replay_t *  recording; // if not NULL, each tick is added to it
 } game_t;
 
 
 game_t *    InitGame( void );
 void        DestroyGame( game_t * );
 void        StartLevel( game_t *, int number);
-void        DrawGame( game_t *);
-void        DoFrame( game_t *, float dt );
+void        UpdateGame( game_t *, float dt );
+void        SetTickRate( game_t *, float ticks_per_second );
+int         AdvanceGame( game_t *, float elapsed );
 
 #endif /* GAME_H */
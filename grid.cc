@@ -0,0 +1,177 @@
+#include "grid.h"
+#include "mylib.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static void * GrowBuffer( void * buffer, int * capacity, int needed, size_t size ) {
+    if ( needed <= *capacity ) {
+        return buffer;
+    }
+    
+    int new_capacity = *capacity ? *capacity : 64;
+    while ( new_capacity < needed ) {
+        new_capacity *= 2;
+    }
+    
+    buffer = realloc( buffer, new_capacity * size );
+    if ( buffer == NULL ) {
+        fprintf( stderr, "%s: realloc failed\n", __func__ );
+        exit( EXIT_FAILURE );
+    }
+    
+    *capacity = new_capacity;
+    return buffer;
+}
+
+
+// wrap a coordinate into [0, size) and find its cell
+static int CellCoord( float v, float size, float cell_size, int num ) {
+    v = fmodf( v, size );
+    if ( v < 0.0f ) {
+        v += size;
+    }
+    
+    int c = (int)( v / cell_size );
+    return c < num ? c : num - 1;
+}
+
+
+// the first count entities in entities
+void BuildGrid( grid_t * grid, const entityPool_t * entities, int count ) {
+    // size cells to the largest entity so overlaps are never more than a
+    // cell apart
+    
+    float max_radius = 0.0f;
+    for ( int i = 0; i < count; i++ ) {
+        float r = EntityRadius( EntityAt( entities, i ) );
+        if ( r > max_radius ) {
+            max_radius = r;
+        }
+    }
+    
+    float cell_size = MAX( max_radius * 2.0f, GRID_MIN_CELL_SIZE );
+    
+    grid->cols = MAX( (int)( GAME_WIDTH / cell_size ), 1 );
+    grid->rows = MAX( (int)( GAME_HEIGHT / cell_size ), 1 );
+    grid->cell_w = (float)GAME_WIDTH / (float)grid->cols;
+    grid->cell_h = (float)GAME_HEIGHT / (float)grid->rows;
+    grid->num_cells = grid->cols * grid->rows;
+    grid->num_items = count;
+    
+    grid->cell_start = (int *)GrowBuffer( grid->cell_start,
+                                          &grid->cell_capacity,
+                                          grid->num_cells + 1,
+                                          sizeof(int) );
+    
+    if ( count > grid->item_capacity ) {
+        int item_capacity = grid->item_capacity;
+        grid->items = (int *)GrowBuffer( grid->items,
+                                         &item_capacity,
+                                         count,
+                                         sizeof(int) );
+        grid->item_cell = (int *)GrowBuffer( grid->item_cell,
+                                             &grid->item_capacity,
+                                             count,
+                                             sizeof(int) );
+    }
+    
+    // counting sort entities into cells, keeping index order within a cell
+    
+    memset( grid->cell_start, 0, ( grid->num_cells + 1 ) * sizeof(int) );
+    
+    for ( int i = 0; i < count; i++ ) {
+        vec2_t * p = &EntityAt( entities, i )->position;
+        int cx = CellCoord( p->x, GAME_WIDTH, grid->cell_w, grid->cols );
+        int cy = CellCoord( p->y, GAME_HEIGHT, grid->cell_h, grid->rows );
+        int cell = cy * grid->cols + cx;
+        
+        grid->item_cell[i] = cell;
+        grid->cell_start[cell + 1]++;
+    }
+    
+    for ( int c = 0; c < grid->num_cells; c++ ) {
+        grid->cell_start[c + 1] += grid->cell_start[c];
+    }
+    
+    // use cell_start as a fill cursor, advancing each cell's start as its
+    // items are written
+    
+    for ( int i = 0; i < count; i++ ) {
+        int cell = grid->item_cell[i];
+        grid->items[grid->cell_start[cell]++] = i;
+    }
+    
+    // the fill advanced each start to the next cell's start; shift back
+    
+    for ( int c = grid->num_cells; c > 0; c-- ) {
+        grid->cell_start[c] = grid->cell_start[c - 1];
+    }
+    grid->cell_start[0] = 0;
+}
+
+
+/*
+ * The cells covering min to max, plus one on each side, as unwrapped cell
+ * coordinates: box is x0, y0, x1, y1 inclusive, for GridCell. Never spans
+ * more than the whole grid, so no cell comes up twice.
+ */
+void GridBox( const grid_t * grid, vec2_t min, vec2_t max, int box[4] ) {
+    box[0] = (int)floorf( min.x / grid->cell_w ) - 1;
+    box[1] = (int)floorf( min.y / grid->cell_h ) - 1;
+    box[2] = MIN( (int)floorf( max.x / grid->cell_w ) + 1, box[0] + grid->cols - 1 );
+    box[3] = MIN( (int)floorf( max.y / grid->cell_h ) + 1, box[1] + grid->rows - 1 );
+}
+
+
+void FreeGrid( grid_t * grid ) {
+    free( grid->cell_start );
+    free( grid->items );
+    free( grid->item_cell );
+    memset( grid, 0, sizeof *grid );
+}
+
+
+// wrapped neighbour offsets along one axis, without duplicates when the
+// grid is fewer than three cells wide
+static int AxisNeighbors( int c, int num, int out[3] ) {
+    int n = 0;
+    for ( int d = -1; d <= 1; d++ ) {
+        int v = ( c + d + num ) % num;
+        
+        bool seen = false;
+        for ( int k = 0; k < n; k++ ) {
+            if ( out[k] == v ) {
+                seen = true;
+            }
+        }
+        
+        if ( !seen ) {
+            out[n++] = v;
+        }
+    }
+    
+    return n;
+}
+
+
+/*
+ * Collect the cell and its (wrapped) surrounding cells. Returns the number
+ * of unique cells written to neighbors.
+ */
+int GridNeighbors( const grid_t * grid, int cell, int neighbors[9] ) {
+    int xs[3], ys[3];
+    int nx = AxisNeighbors( cell % grid->cols, grid->cols, xs );
+    int ny = AxisNeighbors( cell / grid->cols, grid->rows, ys );
+    
+    int n = 0;
+    for ( int y = 0; y < ny; y++ ) {
+        for ( int x = 0; x < nx; x++ ) {
+            neighbors[n++] = ys[y] * grid->cols + xs[x];
+        }
+    }
+    
+    return n;
+}
@@ -0,0 +1,47 @@
+#ifndef grid_h
+#define grid_h
+
+#include "defines.h"
+#include "entitypool.h"
+
+#define GRID_MIN_CELL_SIZE 8.0f
+
+/*
+ * Uniform grid broadphase over the toroidal play field.
+ *
+ * Cells are at least as wide as the largest entity diameter, so any two
+ * overlapping entities are always in the same or adjacent cells. Columns
+ * and rows wrap around, so entities near one edge find neighbours near
+ * the opposite edge.
+ */
+typedef struct
+{
+    int     cols;
+    int     rows;
+    float   cell_w;
+    float   cell_h;
+
+    int     num_cells;
+    int     num_items;
+    int     cell_capacity;
+    int     item_capacity;
+
+    int *   cell_start; // index into items for each cell, num_cells + 1
+    int *   items;      // entity positions in the pool, grouped by cell, ascending
+    int *   item_cell;  // cell of each entity
+} grid_t;
+
+void    BuildGrid( grid_t * grid, const entityPool_t * entities, int count );
+void    FreeGrid( grid_t * grid );
+int     GridNeighbors( const grid_t * grid, int cell, int neighbors[9] );
+void    GridBox( const grid_t * grid, vec2_t min, vec2_t max, int box[4] );
+
+// cell at unwrapped cell coordinates, e.g. from GridBox
+inline int GridCell( const grid_t * grid, int x, int y ) {
+    x %= grid->cols;
+    y %= grid->rows;
+    
+    return ( y < 0 ? y + grid->rows : y ) * grid->cols + ( x < 0 ? x + grid->cols : x );
+}
+
+#endif /* grid_h */
@@ -0,0 +1,23 @@
+#ifndef input_h
+#define input_h
+
+#include "mylib.h"
+
+#define BUTTON_LEFT     0x01
+#define BUTTON_RIGHT    0x02
+#define BUTTON_THRUST   0x04
+#define BUTTON_BRAKE    0x08
+#define BUTTON_FIRE     0x10
+
+/*
+ * Where the simulation gets player input from. poll is called once per
+ * world update and returns the BUTTON_* flags currently held. The SDL
+ * front end reads the keyboard; headless runs can supply anything.
+ */
+typedef struct
+{
+    u32  (* poll)( void * data );
+    void *  data;
+} inputSource_t;
+
+#endif /* input_h */
@@ -0,0 +1,225 @@
+#include "jobs.h"
+#include "mylib.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// a thread's remaining chunks [begin, end), packed so both ends can be
+// taken from with one compare-and-swap
+typedef struct
+{
+    u64     range;
+    u8      pad[56]; // keep each on its own cache line
+} chunkQueue_t;
+
+static struct
+{
+    int             num_threads;
+    pthread_t       threads[MAX_THREADS];
+    
+    pthread_mutex_t lock;
+    pthread_cond_t  start;
+    pthread_cond_t  done;
+    u32             generation; // bumped to start a job
+    u32             created_generation; // as of when the workers started
+    int             idle; // workers finished with the current job
+    bool            quit;
+    
+    chunkFunc_t     func;
+    void *          data;
+    chunkQueue_t    queues[MAX_THREADS];
+} pool = {
+    .num_threads = 1,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .start = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+
+static inline u64 PackRange( u32 begin, u32 end ) {
+    return (u64)end << 32 | begin;
+}
+
+
+// take from the front of our own queue
+static bool PopChunk( chunkQueue_t * queue, int * chunk ) {
+    u64 range = __atomic_load_n( &queue->range, __ATOMIC_ACQUIRE );
+    
+    for ( ;; ) {
+        u32 begin = (u32)range;
+        u32 end = (u32)( range >> 32 );
+        if ( begin >= end ) {
+            return false;
+        }
+        
+        if ( __atomic_compare_exchange_n( &queue->range,
+                                          &range,
+                                          PackRange( begin + 1, end ),
+                                          true,
+                                          __ATOMIC_ACQ_REL,
+                                          __ATOMIC_ACQUIRE ) ) {
+            *chunk = begin;
+            return true;
+        }
+    }
+}
+
+
+// take from the back of someone else's
+static bool StealChunk( chunkQueue_t * queue, int * chunk ) {
+    u64 range = __atomic_load_n( &queue->range, __ATOMIC_ACQUIRE );
+    
+    for ( ;; ) {
+        u32 begin = (u32)range;
+        u32 end = (u32)( range >> 32 );
+        if ( begin >= end ) {
+            return false;
+        }
+        
+        if ( __atomic_compare_exchange_n( &queue->range,
+                                          &range,
+                                          PackRange( begin, end - 1 ),
+                                          true,
+                                          __ATOMIC_ACQ_REL,
+                                          __ATOMIC_ACQUIRE ) ) {
+            *chunk = end - 1;
+            return true;
+        }
+    }
+}
+
+
+static void RunChunks( int thread ) {
+    int chunk;
+    
+    for ( ;; ) {
+        bool found = PopChunk( &pool.queues[thread], &chunk );
+        
+        for ( int i = 1; !found && i < pool.num_threads; i++ ) {
+            int victim = ( thread + i ) % pool.num_threads;
+            found = StealChunk( &pool.queues[victim], &chunk );
+        }
+        
+        if ( !found ) {
+            return;
+        }
+        
+        pool.func( pool.data, chunk, thread );
+    }
+}
+
+
+static void * Worker( void * arg ) {
+    int thread = (int)(intptr_t)arg;
+    
+    pthread_mutex_lock( &pool.lock );
+    u32 seen = pool.created_generation;
+    
+    for ( ;; ) {
+        while ( pool.generation == seen && !pool.quit ) {
+            pthread_cond_wait( &pool.start, &pool.lock );
+        }
+        
+        if ( pool.quit ) {
+            break;
+        }
+        
+        seen = pool.generation;
+        pthread_mutex_unlock( &pool.lock );
+        
+        RunChunks( thread );
+        
+        pthread_mutex_lock( &pool.lock );
+        if ( ++pool.idle == pool.num_threads - 1 ) {
+            pthread_cond_signal( &pool.done );
+        }
+    }
+    
+    pthread_mutex_unlock( &pool.lock );
+    return NULL;
+}
+
+
+static void StopWorkers( void ) {
+    pthread_mutex_lock( &pool.lock );
+    pool.quit = true;
+    pthread_cond_broadcast( &pool.start );
+    pthread_mutex_unlock( &pool.lock );
+    
+    for ( int i = 1; i < pool.num_threads; i++ ) {
+        pthread_join( pool.threads[i], NULL );
+    }
+    
+    pool.quit = false;
+    pool.num_threads = 1;
+}
+
+
+/*
+ * Use count threads, including the caller. Not to be called from inside
+ * ParallelFor.
+ */
+void SetThreadCount( int count ) {
+    count = MAX( 1, MIN( count, MAX_THREADS ) );
+    if ( count == pool.num_threads ) {
+        return;
+    }
+    
+    StopWorkers();
+    
+    // so a worker that starts late still notices the first job
+    pool.created_generation = pool.generation;
+    pool.num_threads = count;
+    for ( int i = 1; i < count; i++ ) {
+        if ( pthread_create( &pool.threads[i], NULL, Worker, (void *)(intptr_t)i ) != 0 ) {
+            fprintf( stderr, "%s: could not create thread %d\n", __func__, i );
+            exit( EXIT_FAILURE );
+        }
+    }
+}
+
+
+int GetThreadCount( void ) {
+    return pool.num_threads;
+}
+
+
+/*
+ * Call func once for each chunk in [0, num_chunks), spread over the
+ * threads, and return when all are done. Which thread runs which chunk
+ * varies from call to call, so anything func produces should be put back
+ * in a fixed order by the caller.
+ */
+void ParallelFor( int num_chunks, chunkFunc_t func, void * data ) {
+    if ( pool.num_threads == 1 || num_chunks <= 1 ) {
+        for ( int i = 0; i < num_chunks; i++ ) {
+            func( data, i, 0 );
+        }
+        return;
+    }
+    
+    pool.func = func;
+    pool.data = data;
+    
+    // contiguous, even shares
+    for ( int t = 0; t < pool.num_threads; t++ ) {
+        u32 begin = (u32)( (long)num_chunks * t / pool.num_threads );
+        u32 end = (u32)( (long)num_chunks * ( t + 1 ) / pool.num_threads );
+        __atomic_store_n( &pool.queues[t].range, PackRange( begin, end ), __ATOMIC_RELAXED );
+    }
+    
+    pthread_mutex_lock( &pool.lock );
+    pool.idle = 0;
+    pool.generation++;
+    pthread_cond_broadcast( &pool.start );
+    pthread_mutex_unlock( &pool.lock );
+    
+    RunChunks( 0 );
+    
+    pthread_mutex_lock( &pool.lock );
+    while ( pool.idle < pool.num_threads - 1 ) {
+        pthread_cond_wait( &pool.done, &pool.lock );
+    }
+    pthread_mutex_unlock( &pool.lock );
+}
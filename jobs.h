@@ -0,0 +1,22 @@
+#ifndef jobs_h
+#define jobs_h
+
+/*
+ * A pool of worker threads for splitting a loop into chunks. Each thread
+ * starts with an even share of the chunks and, when it runs out, steals
+ * from the back of another thread's share. The calling thread takes part
+ * as thread 0.
+ *
+ * With one thread (the default) everything runs on the caller.
+ */
+
+#define MAX_THREADS 64
+
+// thread is in [0, GetThreadCount()), for indexing per-thread data
+typedef void (* chunkFunc_t)( void * data, int chunk, int thread );
+
+void    SetThreadCount( int count );
+int     GetThreadCount( void );
+void    ParallelFor( int num_chunks, chunkFunc_t func, void * data );
+
+#endif /* jobs_h */
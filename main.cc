@@ -5,7 +5,6 @@
  *
  * -------------------------------------------------------------------------- */
 
-#define MYLIB_IMPLEMENTATION
 #include "mylib.h"
 
 #define SPRITE_IMPLEMENTATION
@@ -14,10 +13,15 @@
 #include "defines.h"
 #include "draw.h"
 #include "game.h"
+#include "world.h"
 #include "utility.h"
+#include "profile.h"
+#include "replay.h"
+#include "capture.h"
 
 #include <stdlib.h>
 #include <sys/time.h>
+#include <time.h>
 
 /*  TODO: LIST
     ----------
@@ -36,6 +40,10 @@
 */
 
 static game_t * game;
+static replay_t recording;
+static const char * record_file;
+static capture_t capture;
+static bool capturing;
 
 /*
  * The time since program start in seconds
@@ -54,7 +62,250 @@ float FloatTime() {
 }
 
 
+/*
+ * Monotonic time in seconds, for measuring throughput
+ */
+static double Seconds() {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static u32 PollKeyboard( void * data ) {
+    (void)data;
+    const u8 * keys = SDL_GetKeyboardState( NULL );
+    u32 buttons = 0;
+    
+    if ( keys[SDL_SCANCODE_A] || keys[SDL_SCANCODE_LEFT] ) {
+        buttons |= BUTTON_LEFT;
+    }
+    
+    if ( keys[SDL_SCANCODE_D] || keys[SDL_SCANCODE_RIGHT] ) {
+        buttons |= BUTTON_RIGHT;
+    }
+    
+    if ( keys[SDL_SCANCODE_W] || keys[SDL_SCANCODE_UP] ) {
+        buttons |= BUTTON_THRUST;
+    }
+    
+    if ( keys[SDL_SCANCODE_S] || keys[SDL_SCANCODE_DOWN] ) {
+        buttons |= BUTTON_BRAKE;
+    }
+    
+    if ( keys[SDL_SCANCODE_SPACE] ) {
+        buttons |= BUTTON_FIRE;
+    }
+    
+    return buttons;
+}
+
+
+static void DoEvents() {
+    PROFILE_SCOPE( PHASE_INPUT );
+    
+    SDL_Event event;
+    
+    while ( SDL_PollEvent( &event ) ) {
+        switch ( event.type ) {
+            case SDL_QUIT:
+                exit(EXIT_SUCCESS);
+                break;
+            case SDL_RENDER_TARGETS_RESET:
+            case SDL_RENDER_DEVICE_RESET:
+                InvalidateStarfield();
+                break;
+            case SDL_KEYDOWN:
+                switch ( event.key.keysym.sym ) {
+                    case SDLK_BACKSLASH:
+                        ToggleFullscreen();
+                        break;
+                    case SDLK_F9:
+                        PROFILE_DUMP( PROFILE_FILE );
+                        break;
+                    default:
+                        break;
+                }
+            default:
+                break;
+        }
+    }
+}
+
+
+/*
+ * dt is the real time since the last frame. The simulation runs in fixed
+ * ticks and the drawing interpolates between the last two.
+ */
+static void DoFrame( float dt ) {
+    PROFILE_BEGIN_FRAME();
+    
+    DoEvents();
+    AdvanceGame( game, dt );
+    DrawGame( game );
+    
+    PROFILE_END_FRAME();
+}
+
+
+/*
+ * Scripted input for headless runs, for recording the replay corpus.
+ */
+typedef struct
+{
+    const char *    name;
+    u32             (* poll)( void * data );
+} script_t;
+
+
+static u32 IdleScript( void * data ) {
+    (void)data;
+    return 0;
+}
+
+
+// turn in place, firing as fast as possible
+static u32 ShootingScript( void * data ) {
+    (void)data;
+    return BUTTON_FIRE | ( ( game->frame / 90 ) % 2 ? BUTTON_LEFT : BUTTON_RIGHT );
+}
+
+
+// sweep around the field, thrusting and braking in bursts, firing all the
+// while, to keep asteroids breaking up
+static u32 WavesScript( void * data ) {
+    (void)data;
+    int t = game->frame;
+    u32 buttons = BUTTON_FIRE;
+    
+    if ( t % 120 < 40 ) {
+        buttons |= BUTTON_THRUST;
+    } else if ( t % 120 < 60 ) {
+        buttons |= BUTTON_BRAKE;
+    }
+    
+    buttons |= t % 240 < 120 ? BUTTON_LEFT : BUTTON_RIGHT;
+    
+    return buttons;
+}
+
+
+static const script_t scripts[] = {
+    { "idle", IdleScript },
+    { "shooting", ShootingScript },
+    { "waves", WavesScript },
+};
+
+
+static const script_t * FindScript( const char * name ) {
+    for ( size_t i = 0; i < array_size( scripts ); i++ ) {
+        if ( strcmp( scripts[i].name, name ) == 0 ) {
+            return &scripts[i];
+        }
+    }
+    
+    fprintf( stderr, "unknown script '%s'\n", name );
+    exit( EXIT_FAILURE );
+}
+
+
+/*
+ * Play a recorded session back headless, as fast as possible, checking
+ * the world against the recording after every tick.
+ */
+static bool RunReplay( const char * path ) {
+    replay_t replay;
+    if ( !LoadReplay( &replay, path ) ) {
+        return false;
+    }
+    
+    StartReplay( &replay, game );
+    
+    bool ok = true;
+    int ticks = 0;
+    double start = Seconds();
+    
+    while ( ok && ticks < replay.buttons->count ) {
+        PROFILE_BEGIN_FRAME();
+        UpdateGame( game, game->tick_dt );
+        PROFILE_END_FRAME();
+        
+        ok = CheckReplayTick( &replay, game->world );
+        ++ticks;
+    }
+    
+    double elapsed = Seconds() - start;
+    printf( "%s: %d ticks in %.3f s: %.0f ticks/s, %s\n",
+            path,
+            ticks,
+            elapsed,
+            elapsed > 0.0 ? ticks / elapsed : 0.0,
+            ok ? "ok" : "MISMATCH" );
+    
+    FreeReplay( &replay );
+    return ok;
+}
+
+
+static void SaveRecording( void ) {
+    if ( record_file == NULL ) {
+        return;
+    }
+    
+    if ( SaveReplay( &recording, record_file ) ) {
+        printf( "recorded %d ticks to %s\n", recording.buttons->count, record_file );
+    }
+    
+    FreeReplay( &recording );
+    record_file = NULL;
+}
+
+
+/*
+ * Step the simulation as fast as possible with no window and report the
+ * tick rate. If draw, each tick is also drawn, by the software renderer.
+ */
+static void RunHeadless( int frames, bool draw ) {
+    double start = Seconds();
+    for ( int i = 0; i < frames; i++ ) {
+        PROFILE_BEGIN_FRAME();
+        UpdateGame( game, game->tick_dt );
+        if ( draw ) {
+            DrawGame( game );
+        }
+        if ( capturing ) {
+            PROFILE_SCOPE( PHASE_CAPTURE );
+            if ( !CaptureFrame( &capture,
+                                SoftwareFramebuffer(),
+                                SoftwareColors(),
+                                game->frame ) ) {
+                exit( EXIT_FAILURE );
+            }
+        }
+        PROFILE_END_FRAME();
+    }
+    double elapsed = Seconds() - start;
+    
+    world_t * world = game->world;
+    printf( "%d %s in %.3f s: %.0f %s/s (%d entities, %d particles)\n",
+            frames,
+            draw ? "frames" : "ticks",
+            elapsed,
+            elapsed > 0.0 ? frames / elapsed : 0.0,
+            draw ? "frames" : "ticks",
+            world->entities.count,
+            world->particles.count );
+    
+    if ( capturing ) {
+        printf( "captured %d frames\n", capture.num_captured );
+    }
+}
+
+
 void CleanUp() {
+    SaveRecording();
+    PROFILE_DUMP( PROFILE_FILE );
     DestroyGame( game );
     SDL_DestroyRenderer( renderer );
     SDL_DestroyWindow( window );
@@ -62,16 +313,151 @@ void CleanUp() {
 }
 
 
-int main() {
+int main( int argc, char ** argv ) {
+    broadphase_t broadphase = BROADPHASE_GRID;
+    bool headless = false;
+    bool software = false;
+    int frames = FPS * 60;
+    float tick_rate = FPS;
+    int max_ticks = MAX_TICKS_PER_FRAME;
+    int star_layers = 1;
+    int rotation_steps = 0;
+    u64 seed = (u64)time( NULL );
+    const char * replay_file = NULL;
+    const script_t * script = NULL;
+    
+    for ( int i = 1; i < argc; i++ ) {
+        if ( strcmp( argv[i], "--crosscheck" ) == 0 ) {
+            broadphase = BROADPHASE_CROSS_CHECK;
+        } else if ( strcmp( argv[i], "--bruteforce" ) == 0 ) {
+            broadphase = BROADPHASE_BRUTE_FORCE;
+        } else if ( strcmp( argv[i], "--headless" ) == 0 ) {
+            headless = true;
+        } else if ( strcmp( argv[i], "--software" ) == 0 ) {
+            software = true;
+        } else if ( strcmp( argv[i], "--capture" ) == 0 && i + 1 < argc ) {
+            if ( !SetCaptureImages( &capture, argv[++i] ) ) {
+                exit( EXIT_FAILURE );
+            }
+            capturing = true;
+        } else if ( strcmp( argv[i], "--capture-raw" ) == 0 && i + 1 < argc ) {
+            if ( !OpenRawCapture( &capture, argv[++i] ) ) {
+                exit( EXIT_FAILURE );
+            }
+            capturing = true;
+        } else if ( strcmp( argv[i], "--capture-every" ) == 0 && i + 1 < argc ) {
+            capture.every = atoi( argv[++i] );
+        } else if ( strcmp( argv[i], "--capture-ticks" ) == 0 && i + 1 < argc ) {
+            if ( !ParseCaptureTicks( &capture, argv[++i] ) ) {
+                exit( EXIT_FAILURE );
+            }
+        } else if ( strcmp( argv[i], "--frames" ) == 0 && i + 1 < argc ) {
+            frames = atoi( argv[++i] );
+        } else if ( strcmp( argv[i], "--tickrate" ) == 0 && i + 1 < argc ) {
+            tick_rate = atof( argv[++i] );
+        } else if ( strcmp( argv[i], "--maxticks" ) == 0 && i + 1 < argc ) {
+            max_ticks = atoi( argv[++i] );
+        } else if ( strcmp( argv[i], "--parallax" ) == 0 && i + 1 < argc ) {
+            star_layers = atoi( argv[++i] );
+        } else if ( strcmp( argv[i], "--rotations" ) == 0 && i + 1 < argc ) {
+            rotation_steps = atoi( argv[++i] );
+        } else if ( strcmp( argv[i], "--threads" ) == 0 && i + 1 < argc ) {
+            SetThreadCount( atoi( argv[++i] ) );
+        } else if ( strcmp( argv[i], "--seed" ) == 0 && i + 1 < argc ) {
+            seed = strtoull( argv[++i], NULL, 0 );
+        } else if ( strcmp( argv[i], "--record" ) == 0 && i + 1 < argc ) {
+            record_file = argv[++i];
+        } else if ( strcmp( argv[i], "--replay" ) == 0 && i + 1 < argc ) {
+            replay_file = argv[++i];
+        } else if ( strcmp( argv[i], "--script" ) == 0 && i + 1 < argc ) {
+            script = FindScript( argv[++i] );
+        } else {
+            fprintf( stderr, "usage: %s [--headless] [--software] [--frames N] "
+                     "[--tickrate HZ] [--maxticks N] [--parallax LAYERS] "
+                     "[--rotations STEPS] [--threads N] [--seed N] "
+                     "[--record FILE] [--replay FILE] [--script NAME] "
+                     "[--capture PATTERN.ppm|.png] [--capture-raw FILE] "
+                     "[--capture-every N] [--capture-ticks T1,T2,...] "
+                     "[--crosscheck | --bruteforce]\n", argv[0] );
+            exit( EXIT_FAILURE );
+        }
+    }
+    
+    if ( tick_rate <= 0.0f || max_ticks < 1 ) {
+        fprintf( stderr, "tick rate and max ticks must be positive\n" );
+        exit( EXIT_FAILURE );
+    }
+    
+    // frames are captured from the software renderer, headless
+    if ( capturing ) {
+        headless = true;
+        software = true;
+    }
+    
+    SeedRandom( seed );
+    
+    if ( replay_file ) {
+        game = InitGame();
+        game->world->broadphase = broadphase;
+        bool ok = RunReplay( replay_file );
+        PROFILE_DUMP( PROFILE_FILE );
+        DestroyGame( game );
+        
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    
+    if ( record_file ) {
+        InitReplay( &recording, seed, tick_rate, 1 );
+    }
+    
+    if ( headless ) {
+        game = InitGame();
+        SetTickRate( game, tick_rate );
+        game->world->broadphase = broadphase;
+        if ( script ) {
+            game->world->input.poll = script->poll;
+        }
+        if ( record_file ) {
+            game->recording = &recording;
+        }
+        if ( software ) {
+            InitSoftwareRenderer( false );
+            SetStarLayers( star_layers, STAR_PARALLAX_SPEED );
+        }
+        SeedWorld( game->world, seed );
+        StartLevel( game, 1 );
+        RunHeadless( frames, software );
+        SaveRecording();
+        FreeCapture( &capture );
+        PROFILE_DUMP( PROFILE_FILE );
+        DestroyGame( game );
+        
+        return EXIT_SUCCESS;
+    }
+    
     if ( SDL_Init( SDL_INIT_VIDEO ) < 0 ) {
         fprintf(stderr, "SDL error: %s\n", SDL_GetError());
         exit( EXIT_FAILURE );
     }
 
     InitWindow();
-    InitRenderer();
+    if ( software ) {
+        InitSoftwareRenderer( true );
+    } else {
+        SetRotationCache( rotation_steps, SPRITE_SCALE_STEPS );
+        InitRenderer();
+    }
+    SetStarLayers( star_layers, STAR_PARALLAX_SPEED );
     
     game = InitGame();
+    SetTickRate( game, tick_rate );
+    game->max_ticks = max_ticks;
+    game->world->broadphase = broadphase;
+    game->world->input.poll = PollKeyboard;
+    if ( record_file ) {
+        game->recording = &recording;
+    }
+    SeedWorld( game->world, seed );
     StartLevel( game, 1 );
 
     atexit(CleanUp);
@@ -86,7 +472,7 @@ int main() {
             continue;
         }
                 
-        DoFrame( game, dt );
+        DoFrame( dt );
         
         old_time = new_time;
     }
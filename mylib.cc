@@ -0,0 +1,2 @@
+#define MYLIB_IMPLEMENTATION
+#include "mylib.h"
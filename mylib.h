@@ -8,7 +8,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#ifndef MYLIB_NO_SDL
 #include <SDL2/SDL.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,8 +20,10 @@ extern "C" {
 #define U16_MAX 0xFFFF
 #define U32_MAX 0xFFFFFFFF
 
+#ifndef MYLIB_NO_SDL
 #define CENTERED SDL_WINDOWPOS_CENTERED
 #define LOG_SDL_ERROR fprintf(stderr, "%s: %s\n", __func__, SDL_GetError())
+#endif
 #define LOG_BAD_MALLOC fprintf(stderr, "%s: malloc failed\n", __func__);
 
 #define BIT(n) (1 << n)
@@ -30,7 +34,7 @@ extern "C" {
 #define MIN(a, b) ((a < b) ? (a) : (b))
 #define RANDOM_INDEX(array) Random(0, array_size(array))
 #define RANDOM_ELEMENT(array) array[RANDOM_INDEX(array)]
-#define RANDOM_ANGLE arc4random_uniform(360)
+#define RANDOM_ANGLE RandomFloat( 0.0f, 2.0f * (float)M_PI ) // radians
 
 // declare pt (something with a .x and .y) prior to use
 #define LOOP_2D(pt, w, h)   for ( pt.y = 0; pt.y < h; pt.y++ ) \
@@ -90,16 +94,39 @@ PRINT_DECL(print_int, int);
 PRINT_DECL(print_float, float);
 PRINT_DECL(print_double, double);
 PRINT_DECL(print_ulong, unsigned long);
+#ifndef MYLIB_NO_SDL
 PRINT_DECL(print_sdl_point, SDL_Point);
 PRINT_DECL(print_sdl_rect, SDL_Rect);
+#endif
 
 FILE * OpenFile( const char * file_name, const char * mode );
 
+/*
+ * xoshiro256**: small, fast, and seedable. Each stream of a seed is an
+ * independent sequence, e.g. one per worker thread.
+ */
+typedef struct {
+    u64 s[4];
+} rng_t;
+
+void    SeedRng( rng_t * rng, u64 seed, u64 stream );
+u64     RngNext( rng_t * rng );
+s32     RngInt( rng_t * rng, s32 min, s32 max ); // from min to max - 1
+float   RngFloat( rng_t * rng, float min, float max ); // from min up to max
+float   RngAngle( rng_t * rng ); // in radians, [0, 2 pi)
+void    RngFloats( rng_t * rng, float * out, int count, float min, float max );
+void    RngAngles( rng_t * rng, float * out, int count );
+
+// the shared generator, for anything not tied to a world
+void SeedRandom( u64 seed );
+u64 RandomBits( void );
 s32 Random( s32 min, s32 max ); // from min to max - 1
 float RandomFloat( float min, float max );
 
 int MapInt( int x, int in_min, int in_max, int out_min, int out_max );
+#ifndef MYLIB_NO_SDL
 void SetColor( SDL_Renderer * renderer, SDL_Color color );
+#endif
 
 float Lerp( float a, float b, float w );
 
@@ -116,6 +143,7 @@ PRINT_DEF(print_float, float, "%f")
 PRINT_DEF(print_double, double, "%f")
 PRINT_DEF(print_ulong, unsigned long, "%lu")
 
+#ifndef MYLIB_NO_SDL
 void print_sdl_point(const char * name, SDL_Point point) {
     printf("%s: (%d, %d)\n", name, point.x, point.y);
 }
@@ -123,6 +151,7 @@ void print_sdl_point(const char * name, SDL_Point point) {
 void print_sdl_rect(const char * name, SDL_Rect r) {
     printf("%s: x: %d, y: %d, w: %d, h: %d\n", name, r.x, r.y, r.w, r.h);
 }
+#endif
 
 
 FILE * OpenFile( const char * file_name, const char * mode ) {
@@ -136,14 +165,111 @@ FILE * OpenFile( const char * file_name, const char * mode ) {
 }
 
 
+static u64 SplitMix64( u64 * x ) {
+    u64 z = ( *x += 0x9E3779B97F4A7C15ull );
+    z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ull;
+    z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBull;
+    return z ^ ( z >> 31 );
+}
+
+
+void SeedRng( rng_t * rng, u64 seed, u64 stream ) {
+    u64 x = seed ^ SplitMix64( &stream );
+    
+    for ( int i = 0; i < 4; i++ ) {
+        rng->s[i] = SplitMix64( &x );
+    }
+}
+
+
+static inline u64 RotateLeft( u64 x, int k ) {
+    return ( x << k ) | ( x >> ( 64 - k ) );
+}
+
+
+u64 RngNext( rng_t * rng ) {
+    u64 * s = rng->s;
+    u64 result = RotateLeft( s[1] * 5, 7 ) * 9;
+    u64 t = s[1] << 17;
+    
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = RotateLeft( s[3], 45 );
+    
+    return result;
+}
+
+
+s32 RngInt( rng_t * rng, s32 min, s32 max ) {
+    if ( max <= min ) {
+        return min;
+    }
+    
+    // scale the top 32 bits into range, without a divide
+    u64 range = (u64)( (s64)max - min );
+    return min + (s32)( ( ( RngNext( rng ) >> 32 ) * range ) >> 32 );
+}
+
+
+// 24 random bits to a float in [0, 1)
+#define UNIT_FLOAT(bits) ( (float)(bits) * ( 1.0f / 16777216.0f ) )
+
+
+float RngFloat( rng_t * rng, float min, float max ) {
+    return UNIT_FLOAT( RngNext( rng ) >> 40 ) * ( max - min ) + min;
+}
+
+
+float RngAngle( rng_t * rng ) {
+    return RngFloat( rng, 0.0f, 2.0f * (float)M_PI );
+}
+
+
+// two floats from each 64 bits
+void RngFloats( rng_t * rng, float * out, int count, float min, float max ) {
+    float range = max - min;
+    int i = 0;
+    
+    for ( ; i + 1 < count; i += 2 ) {
+        u64 bits = RngNext( rng );
+        out[i] = UNIT_FLOAT( bits >> 40 ) * range + min;
+        out[i + 1] = UNIT_FLOAT( ( bits >> 8 ) & 0xFFFFFF ) * range + min;
+    }
+    
+    if ( i < count ) {
+        out[i] = RngFloat( rng, min, max );
+    }
+}
+
+
+void RngAngles( rng_t * rng, float * out, int count ) {
+    RngFloats( rng, out, count, 0.0f, 2.0f * (float)M_PI );
+}
+
+
+static rng_t shared_rng = { { 1, 2, 3, 4 } };
+
+
+void SeedRandom( u64 seed ) {
+    SeedRng( &shared_rng, seed, 0 );
+}
+
+
+u64 RandomBits( void ) {
+    return RngNext( &shared_rng );
+}
+
+
 s32 Random( s32 min, s32 max ) {
-    return arc4random_uniform( max - min ) + min;
+    return RngInt( &shared_rng, min, max );
 }
 
 
 float RandomFloat( float min, float max ) {
-    float random = (float)arc4random() / (float)U32_MAX;
-    return random * (max - min) + min;
+    return RngFloat( &shared_rng, min, max );
 }
 
 
@@ -152,9 +278,11 @@ int MapInt( int x, int in_min, int in_max, int out_min, int out_max ) {
 }
 
 
+#ifndef MYLIB_NO_SDL
 void SetColor( SDL_Renderer * renderer, SDL_Color color ) {
     SDL_SetRenderDrawColor( renderer, color.r, color.g, color.b, color.a );
 }
+#endif
 
 
 float Lerp( float a, float b, float w ) {
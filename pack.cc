@@ -0,0 +1,147 @@
+#include "pack.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// FNV-1a
+u32 PackChecksum( const u8 * data, size_t size ) {
+    u32 hash = 2166136261u;
+    for ( size_t i = 0; i < size; i++ ) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    
+    return hash;
+}
+
+
+static bool PackIsValid( const pack_t * pack, const char * path ) {
+    if ( pack->size < sizeof(packHeader_t) ) {
+        fprintf( stderr, "%s: %s is truncated\n", __func__, path );
+        return false;
+    }
+    
+    const packHeader_t * header = (const packHeader_t *)pack->data;
+    
+    if ( memcmp( header->magic, PACK_MAGIC, sizeof header->magic ) != 0 ) {
+        fprintf( stderr, "%s: %s is not an asset pack\n", __func__, path );
+        return false;
+    }
+    
+    if ( header->version != PACK_VERSION ) {
+        fprintf( stderr,
+                 "%s: %s is version %u, expected %d\n",
+                 __func__,
+                 path,
+                 header->version,
+                 PACK_VERSION );
+        return false;
+    }
+    
+    size_t table_end = sizeof(packHeader_t)
+                     + (size_t)header->num_entries * sizeof(packEntry_t);
+    if ( table_end > pack->size ) {
+        fprintf( stderr, "%s: %s is truncated\n", __func__, path );
+        return false;
+    }
+    
+    const u8 * body = pack->data + sizeof(packHeader_t);
+    if ( PackChecksum( body, pack->size - sizeof(packHeader_t) ) != header->checksum ) {
+        fprintf( stderr, "%s: %s is corrupt (bad checksum)\n", __func__, path );
+        return false;
+    }
+    
+    const packEntry_t * entries = (const packEntry_t *)body;
+    for ( u32 i = 0; i < header->num_entries; i++ ) {
+        const packEntry_t * e = &entries[i];
+        
+        if ( e->offset < table_end
+            || e->offset > pack->size
+            || e->size > pack->size - e->offset
+            || memchr( e->name, '\0', PACK_NAME_SIZE ) == NULL ) {
+            fprintf( stderr, "%s: %s: bad entry %u\n", __func__, path, i );
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+
+/*
+ * Map an asset pack. Returns false if it is missing or invalid, and the
+ * caller should fall back to loading loose files.
+ */
+bool OpenPack( pack_t * pack, const char * path ) {
+    memset( pack, 0, sizeof *pack );
+    
+    int fd = open( path, O_RDONLY );
+    if ( fd == -1 ) {
+        if ( errno != ENOENT ) {
+            fprintf( stderr, "%s: %s: %s\n", __func__, path, strerror( errno ) );
+        }
+        return false;
+    }
+    
+    struct stat st;
+    if ( fstat( fd, &st ) == -1 || st.st_size == 0 ) {
+        close( fd );
+        return false;
+    }
+    
+    void * data = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    
+    if ( data == MAP_FAILED ) {
+        fprintf( stderr, "%s: %s: %s\n", __func__, path, strerror( errno ) );
+        return false;
+    }
+    
+    pack->data = (const u8 *)data;
+    pack->size = st.st_size;
+    
+    if ( !PackIsValid( pack, path ) ) {
+        ClosePack( pack );
+        return false;
+    }
+    
+    const packHeader_t * header = (const packHeader_t *)pack->data;
+    pack->entries = (const packEntry_t *)( pack->data + sizeof(packHeader_t) );
+    pack->num_entries = header->num_entries;
+    
+    return true;
+}
+
+
+void ClosePack( pack_t * pack ) {
+    if ( pack->data ) {
+        munmap( (void *)pack->data, pack->size );
+    }
+    
+    memset( pack, 0, sizeof *pack );
+}
+
+
+/*
+ * Returns a pointer into the mapped pack, or NULL if there is no entry
+ * with that name.
+ */
+const u8 * FindPackEntry( const pack_t * pack, const char * name, u32 * size ) {
+    for ( int i = 0; i < pack->num_entries; i++ ) {
+        const packEntry_t * e = &pack->entries[i];
+        
+        if ( strcmp( e->name, name ) == 0 ) {
+            if ( size ) {
+                *size = e->size;
+            }
+            return pack->data + e->offset;
+        }
+    }
+    
+    return NULL;
+}
@@ -0,0 +1,53 @@
+#ifndef pack_h
+#define pack_h
+
+/*
+ * All game assets in one file, mapped into memory at startup instead of
+ * opening each asset separately. Built by `make pack`.
+ *
+ * Layout: a packHeader_t, then num_entries packEntry_t, then the entry
+ * data. The checksum covers everything after the header. Entries are
+ * named by the path of the loose file they were made from and hold:
+ *
+ *  palette     u8 num_colors, then num_colors r, g, b triples
+ *  sprite      u8 width, height, num_frames, then num_frames frames of
+ *              width * height color indices
+ */
+
+#include "mylib.h"
+#include <stddef.h>
+
+#define PACK_FILE       "asteroids.pak"
+#define PACK_MAGIC      "ASTP"
+#define PACK_VERSION    1
+#define PACK_NAME_SIZE  56
+
+typedef struct
+{
+    char    magic[4];
+    u32     version;
+    u32     num_entries;
+    u32     checksum;
+} packHeader_t;
+
+typedef struct
+{
+    char    name[PACK_NAME_SIZE]; // nul terminated
+    u32     offset; // from the start of the file
+    u32     size;
+} packEntry_t;
+
+typedef struct
+{
+    const u8 *          data;
+    size_t              size;
+    const packEntry_t * entries;
+    int                 num_entries;
+} pack_t;
+
+bool        OpenPack( pack_t * pack, const char * path );
+void        ClosePack( pack_t * pack );
+const u8 *  FindPackEntry( const pack_t * pack, const char * name, u32 * size );
+u32         PackChecksum( const u8 * data, size_t size );
+
+#endif /* pack_h */
@@ -0,0 +1,303 @@
+#include "particles.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PARTICLES_X86 1
+#include <immintrin.h>
+#endif
+
+#define PARTICLE_ALIGN 32
+
+typedef int (* particleUpdate_t)( particleSystem_t * ps, float dt );
+
+static void * AllocAligned( size_t size ) {
+    void * buffer;
+    if ( posix_memalign( &buffer, PARTICLE_ALIGN, size ) != 0 ) {
+        fprintf( stderr, "%s: malloc failed\n", __func__ );
+        exit( EXIT_FAILURE );
+    }
+    
+    return buffer;
+}
+
+
+static void * GrowAligned( void * old, int count, int capacity, size_t size ) {
+    void * buffer = AllocAligned( capacity * size );
+    if ( old ) {
+        memcpy( buffer, old, count * size );
+        free( old );
+    }
+    
+    return buffer;
+}
+
+
+static void ReserveParticles( particleSystem_t * ps, int capacity ) {
+    if ( capacity <= ps->capacity ) {
+        return;
+    }
+    
+    // keep a multiple of the widest kernel so aligned loads never straddle
+    capacity = ( capacity + 7 ) & ~7;
+    
+    ps->x = (float *)GrowAligned( ps->x, ps->count, capacity, sizeof(float) );
+    ps->y = (float *)GrowAligned( ps->y, ps->count, capacity, sizeof(float) );
+    ps->vx = (float *)GrowAligned( ps->vx, ps->count, capacity, sizeof(float) );
+    ps->vy = (float *)GrowAligned( ps->vy, ps->count, capacity, sizeof(float) );
+    ps->lifespan = (float *)GrowAligned( ps->lifespan, ps->count, capacity, sizeof(float) );
+    ps->color = (u8 *)GrowAligned( ps->color, ps->count, capacity, sizeof(u8) );
+    ps->capacity = capacity;
+}
+
+
+void InitParticles( particleSystem_t * ps, int capacity ) {
+    memset( ps, 0, sizeof *ps );
+    ReserveParticles( ps, capacity );
+}
+
+
+void FreeParticles( particleSystem_t * ps ) {
+    free( ps->x );
+    free( ps->y );
+    free( ps->vx );
+    free( ps->vy );
+    free( ps->lifespan );
+    free( ps->color );
+    memset( ps, 0, sizeof *ps );
+}
+
+
+void AddParticles( particleSystem_t * ps, const particle_t * array, int num ) {
+    if ( ps->count + num > ps->capacity ) {
+        int capacity = MAX( ps->capacity, 64 );
+        while ( capacity < ps->count + num ) {
+            capacity *= 2;
+        }
+        
+        ReserveParticles( ps, capacity );
+    }
+    
+    for ( int i = 0; i < num; i++ ) {
+        int n = ps->count + i;
+        ps->x[n] = array[i].position.x;
+        ps->y[n] = array[i].position.y;
+        ps->vx[n] = array[i].velocity.x;
+        ps->vy[n] = array[i].velocity.y;
+        ps->lifespan[n] = array[i].lifespan;
+        ps->color[n] = (u8)array[i].color;
+    }
+    
+    ps->count += num;
+}
+
+
+static inline void MoveParticle( particleSystem_t * ps, int dst, int src ) {
+    ps->x[dst] = ps->x[src];
+    ps->y[dst] = ps->y[src];
+    ps->vx[dst] = ps->vx[src];
+    ps->vy[dst] = ps->vy[src];
+    ps->lifespan[dst] = ps->lifespan[src];
+    ps->color[dst] = ps->color[src];
+}
+
+
+/*
+ * Integrate particles [start, count) and pack the survivors down starting
+ * at out. Returns the new particle count. Also finishes off the tail that
+ * doesn't fill a whole vector in the SIMD kernels.
+ */
+static int UpdateRange( particleSystem_t * ps, int start, int out, float dt ) {
+    for ( int i = start; i < ps->count; i++ ) {
+        if ( ps->lifespan[i] > 0.0f ) {
+            ps->lifespan[i] -= dt;
+            ps->x[i] += ps->vx[i] * dt;
+            ps->y[i] += ps->vy[i] * dt;
+        }
+        
+        if ( ps->lifespan[i] > 0.0f ) {
+            if ( out != i ) {
+                MoveParticle( ps, out, i );
+            }
+            ++out;
+        }
+    }
+    
+    return out;
+}
+
+
+static int UpdateScalar( particleSystem_t * ps, float dt ) {
+    return UpdateRange( ps, 0, 0, dt );
+}
+
+
+#ifdef PARTICLES_X86
+
+__attribute__((target("sse2")))
+static int UpdateSSE2( particleSystem_t * ps, float dt ) {
+    const __m128 vdt = _mm_set1_ps( dt );
+    const __m128 zero = _mm_setzero_ps();
+    
+    int out = 0;
+    int i = 0;
+    
+    for ( ; i + 4 <= ps->count; i += 4 ) {
+        // dead lanes neither age nor move
+        __m128 life = _mm_load_ps( &ps->lifespan[i] );
+        __m128 step = _mm_and_ps( _mm_cmpgt_ps( life, zero ), vdt );
+        life = _mm_sub_ps( life, step );
+        
+        __m128 x = _mm_load_ps( &ps->x[i] );
+        __m128 y = _mm_load_ps( &ps->y[i] );
+        x = _mm_add_ps( x, _mm_mul_ps( _mm_load_ps( &ps->vx[i] ), step ) );
+        y = _mm_add_ps( y, _mm_mul_ps( _mm_load_ps( &ps->vy[i] ), step ) );
+        
+        _mm_store_ps( &ps->x[i], x );
+        _mm_store_ps( &ps->y[i], y );
+        _mm_store_ps( &ps->lifespan[i], life );
+        
+        int keep = _mm_movemask_ps( _mm_cmpgt_ps( life, zero ) );
+        
+        if ( keep == 0xF && out == i ) {
+            out += 4; // nothing removed yet, already in place
+            continue;
+        }
+        
+        for ( int lane = 0; lane < 4; lane++ ) {
+            if ( keep & BIT( lane ) ) {
+                MoveParticle( ps, out++, i + lane );
+            }
+        }
+    }
+    
+    return UpdateRange( ps, i, out, dt );
+}
+
+
+__attribute__((target("avx")))
+static int UpdateAVX( particleSystem_t * ps, float dt ) {
+    const __m256 vdt = _mm256_set1_ps( dt );
+    const __m256 zero = _mm256_setzero_ps();
+    
+    int out = 0;
+    int i = 0;
+    
+    for ( ; i + 8 <= ps->count; i += 8 ) {
+        // dead lanes neither age nor move
+        __m256 life = _mm256_load_ps( &ps->lifespan[i] );
+        __m256 step = _mm256_and_ps( _mm256_cmp_ps( life, zero, _CMP_GT_OQ ), vdt );
+        life = _mm256_sub_ps( life, step );
+        
+        __m256 x = _mm256_load_ps( &ps->x[i] );
+        __m256 y = _mm256_load_ps( &ps->y[i] );
+        x = _mm256_add_ps( x, _mm256_mul_ps( _mm256_load_ps( &ps->vx[i] ), step ) );
+        y = _mm256_add_ps( y, _mm256_mul_ps( _mm256_load_ps( &ps->vy[i] ), step ) );
+        
+        _mm256_store_ps( &ps->x[i], x );
+        _mm256_store_ps( &ps->y[i], y );
+        _mm256_store_ps( &ps->lifespan[i], life );
+        
+        int keep = _mm256_movemask_ps( _mm256_cmp_ps( life, zero, _CMP_GT_OQ ) );
+        
+        if ( keep == 0xFF && out == i ) {
+            out += 8; // nothing removed yet, already in place
+            continue;
+        }
+        
+        for ( int lane = 0; lane < 8; lane++ ) {
+            if ( keep & BIT( lane ) ) {
+                MoveParticle( ps, out++, i + lane );
+            }
+        }
+    }
+    
+    return UpdateRange( ps, i, out, dt );
+}
+
+#endif /* PARTICLES_X86 */
+
+
+static particleKernel_t kernel = PARTICLE_KERNEL_AUTO;
+static particleUpdate_t update = NULL;
+
+
+static particleKernel_t DetectKernel( void ) {
+#ifdef PARTICLES_X86
+    __builtin_cpu_init();
+    
+    if ( __builtin_cpu_supports( "avx" ) ) {
+        return PARTICLE_KERNEL_AVX;
+    }
+    
+    if ( __builtin_cpu_supports( "sse2" ) ) {
+        return PARTICLE_KERNEL_SSE2;
+    }
+#endif
+    
+    return PARTICLE_KERNEL_SCALAR;
+}
+
+
+/*
+ * Select the update kernel. Requesting one the CPU can't run falls back
+ * to the scalar kernel.
+ */
+void SetParticleKernel( particleKernel_t k ) {
+    particleKernel_t best = DetectKernel();
+    
+    if ( k == PARTICLE_KERNEL_AUTO ) {
+        k = best;
+    } else if ( k > best ) {
+        k = PARTICLE_KERNEL_SCALAR;
+    }
+    
+    switch ( k ) {
+#ifdef PARTICLES_X86
+        case PARTICLE_KERNEL_SSE2:
+            update = UpdateSSE2;
+            break;
+        case PARTICLE_KERNEL_AVX:
+            update = UpdateAVX;
+            break;
+#endif
+        default:
+            k = PARTICLE_KERNEL_SCALAR;
+            update = UpdateScalar;
+            break;
+    }
+    
+    kernel = k;
+}
+
+
+particleKernel_t GetParticleKernel( void ) {
+    if ( update == NULL ) {
+        SetParticleKernel( PARTICLE_KERNEL_AUTO );
+    }
+    
+    return kernel;
+}
+
+
+const char * ParticleKernelName( particleKernel_t k ) {
+    static const char * names[NUM_PARTICLE_KERNELS] = {
+        [PARTICLE_KERNEL_AUTO] = "auto",
+        [PARTICLE_KERNEL_SCALAR] = "scalar",
+        [PARTICLE_KERNEL_SSE2] = "sse2",
+        [PARTICLE_KERNEL_AVX] = "avx",
+    };
+    
+    return names[k];
+}
+
+
+void UpdateParticleSystem( particleSystem_t * ps, float dt ) {
+    if ( update == NULL ) {
+        SetParticleKernel( PARTICLE_KERNEL_AUTO );
+    }
+    
+    ps->count = update( ps, dt );
+}
@@ -0,0 +1,55 @@
+#ifndef particles_h
+#define particles_h
+
+#include "colors.h"
+#include "vec2.h"
+#include "mylib.h"
+
+typedef struct
+{
+    vec2_t          position;
+    vec2_t          velocity;
+    float           lifespan; // in seconds
+    paletteColor_t    color;
+} particle_t;
+
+
+typedef enum
+{
+    PARTICLE_KERNEL_AUTO, // pick the widest one the CPU supports
+    PARTICLE_KERNEL_SCALAR,
+    PARTICLE_KERNEL_SSE2,
+    PARTICLE_KERNEL_AVX,
+    NUM_PARTICLE_KERNELS
+} particleKernel_t;
+
+
+/*
+ * Particles stored as separate, 32-byte aligned arrays so the update can
+ * run several particles per instruction. Live particles are always packed
+ * at [0, count).
+ */
+typedef struct
+{
+    int     count;
+    int     capacity;
+
+    float * x;
+    float * y;
+    float * vx;
+    float * vy;
+    float * lifespan; // in seconds
+    u8 *    color;
+} particleSystem_t;
+
+
+void InitParticles( particleSystem_t * ps, int capacity );
+void FreeParticles( particleSystem_t * ps );
+void AddParticles( particleSystem_t * ps, const particle_t * array, int num );
+void UpdateParticleSystem( particleSystem_t * ps, float dt );
+
+void                SetParticleKernel( particleKernel_t kernel );
+particleKernel_t    GetParticleKernel( void );
+const char *        ParticleKernelName( particleKernel_t kernel );
+
+#endif /* particles_h */
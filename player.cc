@@ -3,100 +3,107 @@
 #include "world.h"
 #include "entity.h"
 #include "game.h"
+#include "mylib.h"
 
 #define PLAYER_THRUST 100.0f
 #define PLAYER_ROTATION DEG2RAD(180)
-#define PLAYER_SHOT_TIME (FPS / 2)
+#define PLAYER_SHOT_TIME 0.5f // seconds
 #define BULLET_VELOCITY 100.0f
+#define EXHAUST_SPREAD DEG2RAD(10) // either way from straight back
+#define EXHAUST_RATE 60.0f // particles per second
+#define BRAKE_FACTOR 0.975f // speed kept per 1 / FPS seconds of braking
 
 void ResetPlayer( entity_t * player ) {
-    player->info.player.shot_timer = 0;
+    player->info.player.shot_timer = 0.0f;
+    player->info.player.exhaust = 0.0f;
     player->position.x = GAME_WIDTH / 2;
     player->position.y = GAME_HEIGHT / 2;
     player->velocity.zero();
-    player->rotation = 270.0f;
+    player->rotation = PLAYER_START_ROTATION;
+    
+    // teleported, don't draw it sliding across the screen
+    player->prev_position = player->position;
+    player->prev_rotation = player->rotation;
 }
 
 
-void PlayerContact( entity_t * player, entity_t * hit ) {
-    switch ( hit->type ) {
-        case ENTITY_ASTEROID_LARGE:
-        case ENTITY_ASTEROID_MEDIUM:
-        case ENTITY_ASTEROID_SMALL:
-            ExplodeEntity( player );
-            player->state = ES_RESPAWNING;
-            ResetPlayer( player );
-            player->scale = 0.0f;
-            break;
-        default:
-            break;
-    }
+void PlayerHitAsteroid( world_t * world, entity_t * player, entity_t * asteroid ) {
+    (void)asteroid;
+    ExplodeEntity( world, player );
+    player->state = ES_RESPAWNING;
+    ResetPlayer( player );
+    player->scale = 0.0f;
 }
 
 
-static void ShootBullet( entity_t * player ) {
+static void ShootBullet( world_t * world, entity_t * player ) {
     vec2_t forward = EntityForward( player );
     vec2_t pt = forward;
     pt *= EntityRadius( player );
     pt += player->position;
 
-    entity_t * bullet = SpawnEntity( player->world, ENTITY_BULLET, pt, 0.0f );
-    bullet->velocity = forward * BULLET_VELOCITY;
+    entity_t bullet = MakeEntity( ENTITY_BULLET, pt, 0.0f );
+    bullet.velocity = forward * BULLET_VELOCITY;
+    DeferSpawn( world, &bullet );
     
     player->info.player.shot_timer = PLAYER_SHOT_TIME;
 }
 
 
-void DoPlayerInput( entity_t * player, float dt ) {
+void DoPlayerInput( world_t * world, entity_t * player, float dt ) {
     playerInfo_t * info = &player->info.player;
-    const u8 * keys = SDL_GetKeyboardState( NULL );
+    u32 buttons = world->buttons;
     
-    if ( keys[SDL_SCANCODE_A] || keys[SDL_SCANCODE_LEFT] ) {
+    if ( buttons & BUTTON_LEFT ) {
         player->rotation -= PLAYER_ROTATION * dt;
     }
 
-    if ( keys[SDL_SCANCODE_D] || keys[SDL_SCANCODE_RIGHT] ) {
+    if ( buttons & BUTTON_RIGHT ) {
         player->rotation += PLAYER_ROTATION * dt;
     }
     
-    if ( keys[SDL_SCANCODE_W] || keys[SDL_SCANCODE_UP] ) {
+    if ( buttons & BUTTON_THRUST ) {
         vec2_t thrust = ( EntityForward( player ) * PLAYER_THRUST ) * dt;
         player->velocity += thrust;
         
-        int num_particles = 1;
-        Array<particle_t> exhaust( num_particles );
+        // a steady rate whatever the tick length
+        info->exhaust += EXHAUST_RATE * dt;
+        int num_particles = (int)info->exhaust;
+        info->exhaust -= num_particles;
+        
+        rng_t * rng = WorldRng( world );
+        Array<particle_t> exhaust( MAX( num_particles, 1 ) );
         for ( int i = 0; i < num_particles; i++ ) {
             vec2_t back = -(EntityForward( player )) * EntityRadius( player );
             
             particle_t p;
             p.position = back + player->position;
             float offset = 1.0f;
-            p.position.x += RandomFloat( -offset, offset );
-            p.position.y += RandomFloat( -offset, offset );
+            p.position.x += RngFloat( rng, -offset, offset );
+            p.position.y += RngFloat( rng, -offset, offset );
             
-            p.velocity = back * RandomFloat( 10.0f, 15.0f );
-            int span = 10;
-            p.velocity = p.velocity.rotated( Random( -span, span) );
+            p.velocity = back * RngFloat( rng, 10.0f, 15.0f );
+            p.velocity = p.velocity.rotated( RngFloat( rng, -EXHAUST_SPREAD, EXHAUST_SPREAD ) );
             
-            p.lifespan = Random( FPS * 0.5, FPS * 1 );
-            p.color = Random( 0, 2) ? COLOR_YELLOW : COLOR_BRIGHT_RED;
+            p.lifespan = RngFloat( rng, 0.5f, 1.0f );
+            p.color = RngInt( rng, 0, 2 ) ? COLOR_YELLOW : COLOR_BRIGHT_RED;
             
             exhaust.append( p );
         }
         
-        SpawnParticles( player->world, exhaust.buffer, exhaust.count );
+        SpawnParticles( world, exhaust.buffer, exhaust.count );
     }
     
-    if ( keys[SDL_SCANCODE_S] || keys[SDL_SCANCODE_DOWN] ) {
-        player->velocity *= 0.975f;
+    if ( buttons & BUTTON_BRAKE ) {
+        player->velocity *= powf( BRAKE_FACTOR, dt * FPS );
         if ( player->velocity.length() <= 1.0f ) {
             player->velocity.zero();
         }
     }
     
-    if ( keys[SDL_SCANCODE_SPACE] ) {
-        if ( info->shot_timer == 0 ) {
-            ShootBullet( player );
+    if ( buttons & BUTTON_FIRE ) {
+        if ( info->shot_timer <= 0.0f ) {
+            ShootBullet( world, player );
         }
     }
 }
@@ -106,43 +113,27 @@ void DoPlayerInput( entity_t * player, float dt ) {
  * check if the spawn point will be blocked at any
  * point in the next n seconds
  */
-bool SpawnPointBlocked( entity_t * player, int seconds, float dt ) {
-    
-    Array<entity_t> entities = *player->world->entities;
-    
-    // run a simulation to see what's coming
-    for ( int frame = 0; frame < FPS * seconds; frame++ ) {
-        for ( int i = 0; i < entities.count; i++ ) {
-            entity_t * e = &entities.buffer[i];
-            
-            if ( e->type != ENTITY_PLAYER ) {
-                // don't make an changes to the world
-                GeneralUpdateEntity( e, dt );
-                
-                if ( EntitiesAreColliding( e, player ) ) {
-                    return true; // blocked
-                }
-            }
-        }
-    }
+bool SpawnPointBlocked( world_t * world, entity_t * player, float seconds ) {
+    vec2_t spawn = player->position;
+    float radius = EntityRadius( player ); // still 0 while respawning
     
-    return false;
+    return FirstImpact( world, spawn, radius, seconds, player, NULL ) != NULL;
 }
 
 
-void UpdatePlayer( entity_t * player, float dt ) {
+void UpdatePlayer( world_t * world, entity_t * player, float dt ) {
     
     switch ( player->state ) {
         case ES_ACTIVE: {
-            DoPlayerInput( player, dt );
+            DoPlayerInput( world, player, dt );
             
-            if ( player->info.player.shot_timer > 0 ) {
-                --player->info.player.shot_timer;
+            if ( player->info.player.shot_timer > 0.0f ) {
+                player->info.player.shot_timer -= dt;
             }
             break;
         }
         case ES_RESPAWNING: {
-            if ( !SpawnPointBlocked( player, 3, dt ) ) {
+            if ( !SpawnPointBlocked( world, player, 3.0f ) ) {
                 player->state = ES_APPEARING; // respawn
             }
             break;
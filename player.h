@@ -2,9 +2,13 @@
 #define player_h
 
 #include "entity.h"
+#include "defines.h"
 
-void UpdatePlayer( entity_t * player, float dt );
-void PlayerContact( entity_t * player, entity_t * hit );
+#define PLAYER_START_ROTATION DEG2RAD(270) // facing up
+
+void UpdatePlayer( world_t * world, entity_t * player, float dt );
+void PlayerHitAsteroid( world_t * world, entity_t * player, entity_t * asteroid );
 void ResetPlayer( entity_t * player );
+bool SpawnPointBlocked( world_t * world, entity_t * player, float seconds );
 
 #endif /* player_h */
@@ -0,0 +1,103 @@
+#include "profile.h"
+
+#ifdef PROFILE
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static const char * phase_names[NUM_PHASES] = {
+    [PHASE_INPUT]           = "input",
+    [PHASE_ENTITY_UPDATE]   = "entity_update",
+    [PHASE_COLLISION]       = "collision",
+    [PHASE_REMOVAL]         = "removal",
+    [PHASE_COMMANDS]        = "commands",
+    [PHASE_PARTICLE_UPDATE] = "particle_update",
+    [PHASE_DRAW_STARS]      = "draw_stars",
+    [PHASE_DRAW_ENTITIES]   = "draw_entities",
+    [PHASE_DRAW_PARTICLES]  = "draw_particles",
+    [PHASE_PRESENT]         = "present",
+    [PHASE_CAPTURE]         = "capture",
+};
+
+static frameRecord_t records[PROFILE_FRAMES];
+static u32 num_frames; // total frames begun, the newest is num_frames - 1
+static frameRecord_t * current;
+
+
+u64 ProfileTime() {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+
+void ProfileBeginFrame() {
+    current = &records[num_frames % PROFILE_FRAMES];
+    memset( current, 0, sizeof *current );
+    current->frame = num_frames++;
+    current->start = ProfileTime();
+}
+
+
+void ProfileEndFrame() {
+    if ( current ) {
+        current->total = ProfileTime() - current->start;
+        current = NULL;
+    }
+}
+
+
+void ProfileAddTick() {
+    if ( current ) {
+        ++current->ticks;
+    }
+}
+
+
+// phases can run more than once a frame, e.g. several ticks
+void ProfileAdd( profilePhase_t phase, u64 ns ) {
+    if ( current ) {
+        current->phases[phase] += ns;
+    }
+}
+
+
+/*
+ * Write the buffered frames, oldest first, with times in microseconds.
+ */
+bool ProfileDumpCSV( const char * path ) {
+    FILE * file = fopen( path, "w" );
+    if ( file == NULL ) {
+        fprintf( stderr, "%s: could not open %s\n", __func__, path );
+        return false;
+    }
+    
+    fprintf( file, "frame,ticks,total_us" );
+    for ( int p = 0; p < NUM_PHASES; p++ ) {
+        fprintf( file, ",%s_us", phase_names[p] );
+    }
+    fprintf( file, "\n" );
+    
+    // skip the frame still in progress
+    u32 end = current ? num_frames - 1 : num_frames;
+    u32 start = end > PROFILE_FRAMES ? end - PROFILE_FRAMES : 0;
+    
+    for ( u32 f = start; f < end; f++ ) {
+        frameRecord_t * r = &records[f % PROFILE_FRAMES];
+        
+        fprintf( file, "%u,%u,%.3f", r->frame, r->ticks, r->total / 1000.0 );
+        for ( int p = 0; p < NUM_PHASES; p++ ) {
+            fprintf( file, ",%.3f", r->phases[p] / 1000.0 );
+        }
+        fprintf( file, "\n" );
+    }
+    
+    fclose( file );
+    printf( "wrote profile: %s (%u frames)\n", path, end - start );
+    
+    return true;
+}
+
+#endif /* PROFILE */
@@ -0,0 +1,75 @@
+#ifndef profile_h
+#define profile_h
+
+/*
+ * Per-phase frame timing. Build with PROFILE defined (make PROFILE=1) to
+ * enable; otherwise the macros below compile to nothing.
+ *
+ * Each frame's phase times go into a ring buffer holding the last
+ * PROFILE_FRAMES frames, which can be written out as CSV.
+ */
+
+#include "mylib.h"
+
+#define PROFILE_FRAMES  1024
+#define PROFILE_FILE    "profile.csv"
+
+typedef enum
+{
+    PHASE_INPUT,
+    PHASE_ENTITY_UPDATE,
+    PHASE_COLLISION,
+    PHASE_REMOVAL,
+    PHASE_COMMANDS,
+    PHASE_PARTICLE_UPDATE,
+    PHASE_DRAW_STARS,
+    PHASE_DRAW_ENTITIES,
+    PHASE_DRAW_PARTICLES,
+    PHASE_PRESENT,
+    PHASE_CAPTURE,
+    NUM_PHASES
+} profilePhase_t;
+
+typedef struct
+{
+    u32     frame;
+    u32     ticks; // simulation ticks run this frame
+    u64     start; // ns, monotonic
+    u64     total;
+    u64     phases[NUM_PHASES]; // ns spent in each phase
+} frameRecord_t;
+
+#ifdef PROFILE
+
+u64     ProfileTime( void );
+void    ProfileBeginFrame( void );
+void    ProfileEndFrame( void );
+void    ProfileAddTick( void );
+void    ProfileAdd( profilePhase_t phase, u64 ns );
+bool    ProfileDumpCSV( const char * path );
+
+struct profileScope_t {
+    profilePhase_t phase;
+    u64 start;
+
+    profileScope_t( profilePhase_t p ) : phase( p ), start( ProfileTime() ) { }
+    ~profileScope_t() { ProfileAdd( phase, ProfileTime() - start ); }
+};
+
+#define PROFILE_SCOPE(phase)    profileScope_t _profile_scope_( phase )
+#define PROFILE_BEGIN_FRAME()   ProfileBeginFrame()
+#define PROFILE_END_FRAME()     ProfileEndFrame()
+#define PROFILE_TICK()          ProfileAddTick()
+#define PROFILE_DUMP(path)      ProfileDumpCSV( path )
+
+#else
+
+#define PROFILE_SCOPE(phase)
+#define PROFILE_BEGIN_FRAME()
+#define PROFILE_END_FRAME()
+#define PROFILE_TICK()
+#define PROFILE_DUMP(path)
+
+#endif /* PROFILE */
+
+#endif /* profile_h */
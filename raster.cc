@@ -0,0 +1,173 @@
+#include "raster.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define FIXED_SHIFT 16
+#define TO_FIXED(f) ( (s32)( (f) * (float)( 1 << FIXED_SHIFT ) ) )
+
+void InitFramebuffer( framebuffer_t * fb, int width, int height ) {
+    fb->width = width;
+    fb->height = height;
+    fb->pixels = (u8 *)malloc( width * height );
+    
+    if ( fb->pixels == NULL ) {
+        LOG_BAD_MALLOC;
+        exit( EXIT_FAILURE );
+    }
+    
+    ClearFramebuffer( fb, 0 );
+}
+
+
+void FreeFramebuffer( framebuffer_t * fb ) {
+    free( fb->pixels );
+    memset( fb, 0, sizeof *fb );
+}
+
+
+void ClearFramebuffer( framebuffer_t * fb, u8 color ) {
+    memset( fb->pixels, color, fb->width * fb->height );
+}
+
+
+// copy a row of n pixels, leaving dst alone where src is transparent
+static void BlitRow( u8 * dst, const u8 * src, int n ) {
+    int i = 0;
+    
+#ifdef __SSE2__
+    const __m128i key = _mm_set1_epi8( (char)RASTER_TRANSPARENT );
+    
+    for ( ; i + 16 <= n; i += 16 ) {
+        __m128i s = _mm_loadu_si128( (const __m128i *)( src + i ) );
+        __m128i d = _mm_loadu_si128( (const __m128i *)( dst + i ) );
+        __m128i transparent = _mm_cmpeq_epi8( s, key );
+        
+        d = _mm_or_si128( _mm_and_si128( transparent, d ),
+                          _mm_andnot_si128( transparent, s ) );
+        _mm_storeu_si128( (__m128i *)( dst + i ), d );
+    }
+#endif
+    
+    for ( ; i < n; i++ ) {
+        if ( src[i] != RASTER_TRANSPARENT ) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+
+/*
+ * Draw image unscaled and unrotated with its top left corner at (x, y),
+ * clipped to the framebuffer.
+ */
+void BlitImage( framebuffer_t * fb, const rasterImage_t * image, int x, int y ) {
+    int x0 = MAX( x, 0 );
+    int y0 = MAX( y, 0 );
+    int x1 = MIN( x + image->width, fb->width );
+    int y1 = MIN( y + image->height, fb->height );
+    
+    if ( x0 >= x1 || y0 >= y1 ) {
+        return;
+    }
+    
+    for ( int row = y0; row < y1; row++ ) {
+        const u8 * src = image->pixels + ( row - y ) * image->width + ( x0 - x );
+        BlitRow( fb->pixels + row * fb->width + x0, src, x1 - x0 );
+    }
+}
+
+
+/*
+ * Draw image stretched to width * height and rotated radians clockwise
+ * about its center, which is at (cx, cy), with nearest neighbour sampling.
+ *
+ * Each framebuffer pixel in the rotated bounds is mapped back into the
+ * image; along a row that's a constant step, so the inner loop is two
+ * fixed point adds, a bounds check and a lookup.
+ */
+void BlitRotated
+ (  framebuffer_t * fb,
+    const rasterImage_t * image,
+    float cx,
+    float cy,
+    int width,
+    int height,
+    float radians )
+{
+    if ( width <= 0 || height <= 0 ) {
+        return;
+    }
+    
+    float c = cosf( radians );
+    float s = sinf( radians );
+    
+    float extent_x = ( fabsf( width * c ) + fabsf( height * s ) ) * 0.5f;
+    float extent_y = ( fabsf( width * s ) + fabsf( height * c ) ) * 0.5f;
+    int x0 = MAX( (int)floorf( cx - extent_x ), 0 );
+    int y0 = MAX( (int)floorf( cy - extent_y ), 0 );
+    int x1 = MIN( (int)ceilf( cx + extent_x ), fb->width );
+    int y1 = MIN( (int)ceilf( cy + extent_y ), fb->height );
+    
+    if ( x0 >= x1 || y0 >= y1 ) {
+        return;
+    }
+    
+    // image pixels per framebuffer pixel
+    float to_u = (float)image->width / width;
+    float to_v = (float)image->height / height;
+    
+    s32 du = TO_FIXED( c * to_u );
+    s32 dv = TO_FIXED( -s * to_v );
+    u32 u_end = (u32)image->width << FIXED_SHIFT;
+    u32 v_end = (u32)image->height << FIXED_SHIFT;
+    
+    for ( int y = y0; y < y1; y++ ) {
+        // the first pixel center of the row, in the unrotated image
+        float dx = x0 + 0.5f - cx;
+        float dy = y + 0.5f - cy;
+        s32 u = TO_FIXED( ( dx * c + dy * s + width * 0.5f ) * to_u );
+        s32 v = TO_FIXED( ( -dx * s + dy * c + height * 0.5f ) * to_v );
+        
+        u8 * dst = fb->pixels + y * fb->width;
+        
+        for ( int x = x0; x < x1; x++, u += du, v += dv ) {
+            // negative coordinates wrap to large unsigned ones
+            if ( (u32)u >= u_end || (u32)v >= v_end ) {
+                continue;
+            }
+            
+            u8 p = image->pixels[( v >> FIXED_SHIFT ) * image->width + ( u >> FIXED_SHIFT )];
+            if ( p != RASTER_TRANSPARENT ) {
+                dst[x] = p;
+            }
+        }
+    }
+}
+
+
+/*
+ * Look up every pixel's color, writing rows out_pitch bytes apart, e.g.
+ * into a locked streaming texture.
+ */
+void ConvertFramebuffer
+ (  const framebuffer_t * fb,
+    const u32 colors[256],
+    u32 * out,
+    int out_pitch )
+{
+    for ( int y = 0; y < fb->height; y++ ) {
+        const u8 * src = fb->pixels + y * fb->width;
+        u32 * dst = (u32 *)( (u8 *)out + y * out_pitch );
+        
+        for ( int x = 0; x < fb->width; x++ ) {
+            dst[x] = colors[src[x]];
+        }
+    }
+}
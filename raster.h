@@ -0,0 +1,58 @@
+#ifndef raster_h
+#define raster_h
+
+/*
+ * Software rendering into a framebuffer of 8-bit palette indices, one byte
+ * per pixel, rows packed. Nothing here needs SDL or a window: converting
+ * to colors and showing the result is up to the caller, see
+ * ConvertFramebuffer.
+ *
+ * Images are width * height palette indices; RASTER_TRANSPARENT pixels
+ * (the same as SPRITE_TRANSPARENT) are skipped.
+ */
+
+#include "mylib.h"
+
+#define RASTER_TRANSPARENT 0xFF
+
+typedef struct framebuffer
+{
+    int     width;
+    int     height;
+    u8 *    pixels;
+} framebuffer_t;
+
+typedef struct
+{
+    const u8 *  pixels;
+    int         width;
+    int         height;
+} rasterImage_t;
+
+void    InitFramebuffer( framebuffer_t * fb, int width, int height );
+void    FreeFramebuffer( framebuffer_t * fb );
+void    ClearFramebuffer( framebuffer_t * fb, u8 color );
+
+void    BlitImage( framebuffer_t * fb, const rasterImage_t * image, int x, int y );
+void    BlitRotated
+ (  framebuffer_t * fb,
+    const rasterImage_t * image,
+    float cx,
+    float cy,
+    int width,
+    int height,
+    float radians );
+
+void    ConvertFramebuffer
+ (  const framebuffer_t * fb,
+    const u32 colors[256],
+    u32 * out,
+    int out_pitch );
+
+inline void PlotPoint( framebuffer_t * fb, int x, int y, u8 color ) {
+    if ( (unsigned)x < (unsigned)fb->width && (unsigned)y < (unsigned)fb->height ) {
+        fb->pixels[y * fb->width + x] = color;
+    }
+}
+
+#endif /* raster_h */
@@ -0,0 +1,250 @@
+#include "replay.h"
+#include "game.h"
+#include "world.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#define REPLAY_HEADER_SIZE 32 // replayHeader_t's fields, packed
+
+static void PutLE( u8 * p, u64 value, int size ) {
+    for ( int i = 0; i < size; i++ ) {
+        p[i] = (u8)( value >> ( i * 8 ) );
+    }
+}
+
+
+static u64 GetLE( const u8 * p, int size ) {
+    u64 value = 0;
+    for ( int i = 0; i < size; i++ ) {
+        value |= (u64)p[i] << ( i * 8 );
+    }
+    
+    return value;
+}
+
+
+static void EncodeHeader( const replayHeader_t * header, u8 out[REPLAY_HEADER_SIZE] ) {
+    u32 tick_rate;
+    memcpy( &tick_rate, &header->tick_rate, sizeof tick_rate );
+    
+    memcpy( out, header->magic, sizeof header->magic );
+    PutLE( out + 4, header->version, 4 );
+    PutLE( out + 8, header->seed, 8 );
+    PutLE( out + 16, tick_rate, 4 );
+    PutLE( out + 20, header->level, 4 );
+    PutLE( out + 24, header->num_ticks, 4 );
+    PutLE( out + 28, header->reserved, 4 );
+}
+
+
+static void DecodeHeader( const u8 in[REPLAY_HEADER_SIZE], replayHeader_t * header ) {
+    u32 tick_rate = (u32)GetLE( in + 16, 4 );
+    
+    memcpy( header->magic, in, sizeof header->magic );
+    header->version = (u32)GetLE( in + 4, 4 );
+    header->seed = GetLE( in + 8, 8 );
+    memcpy( &header->tick_rate, &tick_rate, sizeof tick_rate );
+    header->level = (u32)GetLE( in + 20, 4 );
+    header->num_ticks = (u32)GetLE( in + 24, 4 );
+    header->reserved = (u32)GetLE( in + 28, 4 );
+}
+
+
+void InitReplay( replay_t * replay, u64 seed, float tick_rate, int level ) {
+    replay->seed = seed;
+    replay->tick_rate = tick_rate;
+    replay->level = level;
+    replay->buttons = new Array<u8>( 1024 );
+    replay->hashes = new Array<u32>( 1024 );
+    replay->cursor = 0;
+}
+
+
+void FreeReplay( replay_t * replay ) {
+    delete replay->buttons;
+    delete replay->hashes;
+    memset( replay, 0, sizeof *replay );
+}
+
+
+bool SaveReplay( const replay_t * replay, const char * path ) {
+    FILE * file = fopen( path, "wb" );
+    if ( file == NULL ) {
+        fprintf( stderr, "%s: could not open %s\n", __func__, path );
+        return false;
+    }
+    
+    replayHeader_t header;
+    memset( &header, 0, sizeof header );
+    memcpy( header.magic, REPLAY_MAGIC, sizeof header.magic );
+    header.version = REPLAY_VERSION;
+    header.seed = replay->seed;
+    header.tick_rate = replay->tick_rate;
+    header.level = replay->level;
+    header.num_ticks = replay->buttons->count;
+    
+    u8 header_bytes[REPLAY_HEADER_SIZE];
+    EncodeHeader( &header, header_bytes );
+    
+    Array<u8> hash_bytes( header.num_ticks * 4 );
+    hash_bytes.count = header.num_ticks * 4;
+    for ( u32 i = 0; i < header.num_ticks; i++ ) {
+        PutLE( hash_bytes.buffer + i * 4, replay->hashes->buffer[i], 4 );
+    }
+    
+    bool ok = fwrite( header_bytes, sizeof header_bytes, 1, file ) == 1
+        && fwrite( replay->buttons->buffer, 1, header.num_ticks, file ) == header.num_ticks
+        && fwrite( hash_bytes.buffer, 4, header.num_ticks, file ) == header.num_ticks;
+    
+    if ( fclose( file ) != 0 ) {
+        ok = false;
+    }
+    
+    if ( !ok ) {
+        fprintf( stderr, "%s: could not write %s\n", __func__, path );
+    }
+    
+    return ok;
+}
+
+
+bool LoadReplay( replay_t * replay, const char * path ) {
+    FILE * file = fopen( path, "rb" );
+    if ( file == NULL ) {
+        fprintf( stderr, "%s: could not open %s\n", __func__, path );
+        return false;
+    }
+    
+    u8 header_bytes[REPLAY_HEADER_SIZE];
+    if ( fread( header_bytes, sizeof header_bytes, 1, file ) != 1 ) {
+        fprintf( stderr, "%s: %s is truncated\n", __func__, path );
+        fclose( file );
+        return false;
+    }
+    
+    replayHeader_t header;
+    DecodeHeader( header_bytes, &header );
+    
+    if ( memcmp( header.magic, REPLAY_MAGIC, sizeof header.magic ) != 0 ) {
+        fprintf( stderr, "%s: %s is not a replay\n", __func__, path );
+        fclose( file );
+        return false;
+    }
+    
+    if ( header.version != REPLAY_VERSION ) {
+        fprintf( stderr,
+                 "%s: %s is version %u, expected %d\n",
+                 __func__,
+                 path,
+                 header.version,
+                 REPLAY_VERSION );
+        fclose( file );
+        return false;
+    }
+    
+    if ( !( header.tick_rate > 0.0f ) ) {
+        fprintf( stderr, "%s: %s has a bad header\n", __func__, path );
+        fclose( file );
+        return false;
+    }
+    
+    // the header's count must account for exactly the rest of the file,
+    // before it's trusted with any allocation
+    struct stat st;
+    if ( fstat( fileno( file ), &st ) != 0
+        || header.num_ticks > INT_MAX / 5
+        || (u64)REPLAY_HEADER_SIZE + (u64)header.num_ticks * 5 != (u64)st.st_size ) {
+        fprintf( stderr,
+                 "%s: %s is the wrong size for %u ticks\n",
+                 __func__,
+                 path,
+                 header.num_ticks );
+        fclose( file );
+        return false;
+    }
+    
+    InitReplay( replay, header.seed, header.tick_rate, header.level );
+    
+    int num_ticks = header.num_ticks;
+    replay->buttons->reserve( num_ticks );
+    replay->hashes->reserve( num_ticks );
+    
+    Array<u8> hash_bytes( num_ticks * 4 );
+    
+    bool ok = fread( replay->buttons->buffer, 1, num_ticks, file ) == header.num_ticks
+        && fread( hash_bytes.buffer, 4, num_ticks, file ) == header.num_ticks;
+    fclose( file );
+    
+    for ( int i = 0; ok && i < num_ticks; i++ ) {
+        replay->hashes->buffer[i] = (u32)GetLE( hash_bytes.buffer + i * 4, 4 );
+    }
+    
+    if ( !ok ) {
+        fprintf( stderr, "%s: %s is truncated\n", __func__, path );
+        FreeReplay( replay );
+        return false;
+    }
+    
+    replay->buttons->count = num_ticks;
+    replay->hashes->count = num_ticks;
+    
+    return true;
+}
+
+
+void RecordTick( replay_t * replay, world_t * world ) {
+    replay->buttons->append( (u8)world->buttons );
+    replay->hashes->append( WorldHash( world ) );
+}
+
+
+// buttons for the next tick, none once the replay runs out
+static u32 PlayReplayInput( void * data ) {
+    replay_t * replay = (replay_t *)data;
+    
+    if ( replay->cursor >= replay->buttons->count ) {
+        return 0;
+    }
+    
+    return replay->buttons->buffer[replay->cursor++];
+}
+
+
+void StartReplay( replay_t * replay, game_t * game ) {
+    replay->cursor = 0;
+    
+    SetTickRate( game, replay->tick_rate );
+    SeedWorld( game->world, replay->seed );
+    game->world->input.poll = PlayReplayInput;
+    game->world->input.data = replay;
+    StartLevel( game, replay->level );
+}
+
+
+/*
+ * Compare the world after a tick of playback with the recording. Returns
+ * false, and says where, on the first difference.
+ */
+bool CheckReplayTick( replay_t * replay, world_t * world ) {
+    int tick = replay->cursor - 1;
+    u32 hash = WorldHash( world );
+    
+    if ( tick < 0 || tick >= replay->hashes->count ) {
+        return true; // past the end, nothing to check against
+    }
+    
+    if ( hash != replay->hashes->buffer[tick] ) {
+        fprintf( stderr,
+                 "%s: tick %d: world hash %08x, recorded %08x\n",
+                 __func__,
+                 tick,
+                 hash,
+                 replay->hashes->buffer[tick] );
+        return false;
+    }
+    
+    return true;
+}
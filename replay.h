@@ -0,0 +1,62 @@
+#ifndef replay_h
+#define replay_h
+
+/*
+ * A recorded session: the world seed, tick rate and starting level, then
+ * the buttons held and a hash of the world after every tick. Playing one
+ * back feeds the same buttons through the simulation and checks each
+ * tick's hash, so a replay is both a fixed workload and a regression test.
+ *
+ * Layout: replayHeader_t's fields in order with no padding (32 bytes),
+ * then num_ticks u8 BUTTON_* flags, then num_ticks u32 hashes (see
+ * WorldHash), all little endian whatever the machine.
+ *
+ * Hashes depend on exact float results, so they only match between builds
+ * using the same compiler settings and math library. Re-record the corpus
+ * (make corpus) after a change that is meant to alter the simulation.
+ */
+
+#include "mylib.h"
+#include "array.h"
+
+#define REPLAY_MAGIC    "ASTR"
+#define REPLAY_VERSION  1
+
+typedef struct game game_t;
+typedef struct world world_t;
+
+typedef struct
+{
+    char    magic[4];
+    u32     version;
+    u64     seed;
+    float   tick_rate;
+    u32     level;
+    u32     num_ticks;
+    u32     reserved;
+} replayHeader_t;
+
+typedef struct replay
+{
+    u64             seed;
+    float           tick_rate;
+    int             level;
+
+    Array<u8> *     buttons; // per tick
+    Array<u32> *    hashes;
+    int             cursor; // the next tick to play back
+} replay_t;
+
+void    InitReplay( replay_t * replay, u64 seed, float tick_rate, int level );
+void    FreeReplay( replay_t * replay );
+bool    SaveReplay( const replay_t * replay, const char * path );
+bool    LoadReplay( replay_t * replay, const char * path );
+
+// while recording, after each tick
+void    RecordTick( replay_t * replay, world_t * world );
+
+// set up a new game to play the replay back
+void    StartReplay( replay_t * replay, game_t * game );
+bool    CheckReplayTick( replay_t * replay, world_t * world );
+
+#endif /* replay_h */
@@ -18,13 +18,18 @@ typedef struct {
     SDL_Color colors[SPRITE_MAX_COLORS];
 } Palette;
 
+// header of a .px file, followed by SPRITE_MAX_FRAMES frames of
+// SPRITE_MAX_SIZE pixels each, of which only width * height are used
+#define SPRITE_FILE_HEADER_SIZE 3
+
+// pixels holds num_frames frames of width * height color indices, one
+// after the other
 typedef struct {
-    struct {
-        u8 width;
-        u8 height;
-        u8 num_frames;
-        u8 pixels[SPRITE_MAX_FRAMES][SPRITE_MAX_SIZE];
-    } data;
+    u8 width;
+    u8 height;
+    u8 num_frames;
+    u8 * pixels;
+    bool borrowed; // pixels belong to someone else, e.g. a mapped asset pack
     SDL_Texture * texture;
 } Sprite;
 
@@ -37,12 +42,20 @@ typedef struct {
 } SpriteDrawInfo;
 
 Palette LoadPalette(const char * file_name);
-Sprite LoadSprite(SDL_Renderer * renderer, const char * file_name, Palette palette);
-Sprite NewSprite(u8 width, u8 height);
+Palette PaletteFromMemory(const u8 * data, u32 size);
+void LoadSpriteData(Sprite * sprite, const char * file_name);
+bool SpriteFromMemory(Sprite * sprite, const u8 * data, u32 size);
+void LoadSprite(SDL_Renderer * renderer, Sprite * sprite, const char * file_name, Palette palette);
+void NewSprite(Sprite * sprite, u8 width, u8 height);
+void FreeSprite(Sprite * sprite);
 void UpdateSpriteTexture(SDL_Renderer * renderer, Sprite * sprite, Palette palette);
-void DrawSprite(SDL_Renderer * renderer, Sprite sprite, SpriteDrawInfo info);
+void DrawSprite(SDL_Renderer * renderer, const Sprite * sprite, const SpriteDrawInfo * info);
 void SetColor(SDL_Renderer * renderer, SDL_Color color);
 
+static inline u8 * SpriteFrame(const Sprite * sprite, int frame) {
+    return sprite->pixels + frame * sprite->width * sprite->height;
+}
+
 #ifdef SPRITE_IMPLEMENTATION
 
 Palette LoadPalette(const char * file_name) {
@@ -81,26 +94,44 @@ Palette LoadPalette(const char * file_name) {
     return palette;
 }
 
-static SDL_Surface * CreateSurfaceFromSprite(Sprite sprite, Palette palette) {
+// read a palette stored as its color count followed by r, g, b triples
+Palette PaletteFromMemory(const u8 * data, u32 size) {
+    Palette palette;
+    memset(&palette, 0, sizeof(palette));
+    
+    if ( size < 1 || data[0] > SPRITE_MAX_COLORS || size < 1u + data[0] * 3u ) {
+        printf("error: bad palette data\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    palette.num_colors = data[0];
+    for ( int i = 0; i < palette.num_colors; i++ ) {
+        const u8 * rgb = &data[1 + i * 3];
+        palette.colors[i] = (SDL_Color){ rgb[0], rgb[1], rgb[2], 0xFF };
+    }
+    
+    return palette;
+}
+
+static SDL_Surface * CreateSurfaceFromSprite(const Sprite * sprite, Palette palette) {
     SDL_Surface * surface = SDL_CreateRGBSurface
         (0,
-         sprite.data.width * sprite.data.num_frames,
-         sprite.data.height,
+         sprite->width * sprite->num_frames,
+         sprite->height,
          8, 0, 0, 0, 0);
     
     SDL_SetColorKey(surface, SDL_TRUE, SPRITE_TRANSPARENT);
     SDL_SetPaletteColors(surface->format->palette, palette.colors, 0, palette.num_colors);
     
     SDL_LockSurface(surface);
-    for ( int frame = 0; frame < sprite.data.num_frames; frame++ ) {
-        for ( int y = 0; y < sprite.data.height; y++ ) {
-            for ( int x = 0; x < sprite.data.width; x++ ) {
-                int surface_position = y * surface->pitch + x + frame * sprite.data.width;
-                u8 * pixel = (u8 *)surface->pixels + surface_position;
-                
-                int sprite_position = y * sprite.data.width + x;
-                *pixel = sprite.data.pixels[frame][sprite_position];
-            }
+    for ( int frame = 0; frame < sprite->num_frames; frame++ ) {
+        const u8 * pixels = SpriteFrame(sprite, frame);
+        
+        for ( int y = 0; y < sprite->height; y++ ) {
+            int surface_position = y * surface->pitch + frame * sprite->width;
+            memcpy((u8 *)surface->pixels + surface_position,
+                   pixels + y * sprite->width,
+                   sprite->width);
         }
     }
     SDL_UnlockSurface(surface);
@@ -117,81 +148,142 @@ void UpdateSpriteTexture(SDL_Renderer * renderer,
         sprite->texture = NULL;
     }
     
-    SDL_Surface * surface = CreateSurfaceFromSprite(*sprite, palette);
+    SDL_Surface * surface = CreateSurfaceFromSprite(sprite, palette);
     sprite->texture = SDL_CreateTextureFromSurface(renderer, surface);
     SDL_FreeSurface(surface);
 }
 
-Sprite LoadSprite(SDL_Renderer * renderer,
-                  const char * file_name,
-                  Palette palette) {
-    FILE * file = fopen(file_name, "r");
-    if ( file == NULL ) {
-        printf("error: could not open %s!\n", file_name);
+// read a .px file, keeping only the pixels the sprite actually uses
+void LoadSpriteData(Sprite * sprite, const char * file_name) {
+    FILE * file = OpenFile(file_name, "rb");
+    
+    u8 header[SPRITE_FILE_HEADER_SIZE];
+    if ( fread(header, sizeof(header), 1, file) != 1 ) {
+        printf("load sprite error: could not read file %s\n", file_name);
         exit(EXIT_FAILURE);
     }
     
-    Sprite sprite;
-    memset(&sprite, 0, sizeof(sprite));
+    memset(sprite, 0, sizeof(*sprite));
+    sprite->width = header[0];
+    sprite->height = header[1];
+    sprite->num_frames = header[2];
     
-    if ( fread(&sprite.data, sizeof(sprite.data), 1, file) != 1 ) {
-        printf("load sprite error: could not read file %s\n", file_name);
+    int frame_size = sprite->width * sprite->height;
+    
+    if ( sprite->num_frames > SPRITE_MAX_FRAMES || frame_size > SPRITE_MAX_SIZE ) {
+        printf("load sprite error: %s is %dx%d with %d frames\n",
+               file_name, sprite->width, sprite->height, sprite->num_frames);
         exit(EXIT_FAILURE);
     }
     
+    // + 1 so an empty sprite still gets a buffer
+    sprite->pixels = (u8 *)malloc(frame_size * sprite->num_frames + 1);
+    if ( sprite->pixels == NULL ) {
+        printf("load sprite error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    for ( int frame = 0; frame < sprite->num_frames; frame++ ) {
+        long offset = SPRITE_FILE_HEADER_SIZE + (long)frame * SPRITE_MAX_SIZE;
+        
+        if ( fseek(file, offset, SEEK_SET) != 0
+            || fread(SpriteFrame(sprite, frame), 1, frame_size, file) != (size_t)frame_size ) {
+            printf("load sprite error: could not read file %s\n", file_name);
+            exit(EXIT_FAILURE);
+        }
+    }
+    
     fclose(file);
+}
 
-    UpdateSpriteTexture(renderer, &sprite, palette);
-        
-    return sprite;
+// use a sprite stored as width, height, num_frames and then its pixels,
+// without copying them. data must outlive the sprite.
+bool SpriteFromMemory(Sprite * sprite, const u8 * data, u32 size) {
+    memset(sprite, 0, sizeof(*sprite));
+    
+    if ( size < SPRITE_FILE_HEADER_SIZE ) {
+        return false;
+    }
+    
+    int frame_size = data[0] * data[1];
+    if ( data[2] > SPRITE_MAX_FRAMES
+        || size < (u32)(SPRITE_FILE_HEADER_SIZE + frame_size * data[2]) ) {
+        return false;
+    }
+    
+    sprite->width = data[0];
+    sprite->height = data[1];
+    sprite->num_frames = data[2];
+    sprite->pixels = (u8 *)data + SPRITE_FILE_HEADER_SIZE;
+    sprite->borrowed = true;
+    
+    return true;
+}
+
+void LoadSprite(SDL_Renderer * renderer,
+                Sprite * sprite,
+                const char * file_name,
+                Palette palette) {
+    LoadSpriteData(sprite, file_name);
+    UpdateSpriteTexture(renderer, sprite, palette);
 }
 
-Sprite NewSprite(u8 width, u8 height)
+void NewSprite(Sprite * sprite, u8 width, u8 height)
 {
-    Sprite sprite = {
-        .data = {
-            .width = width,
-            .height = height,
-            .num_frames = SPRITE_MAX_FRAMES,
-        }
-    };
-        
-    for ( int frame = 0; frame < SPRITE_MAX_FRAMES; frame++ ) {
-        for ( int pixel = 0; pixel < SPRITE_MAX_SIZE; pixel++ ) {
-            sprite.data.pixels[frame][pixel] = SPRITE_TRANSPARENT;
-        }
+    int size = width * height * SPRITE_MAX_FRAMES;
+    
+    memset(sprite, 0, sizeof(*sprite));
+    sprite->width = width;
+    sprite->height = height;
+    sprite->num_frames = SPRITE_MAX_FRAMES;
+    sprite->pixels = (u8 *)malloc(size + 1); // + 1 in case it is empty
+    if ( sprite->pixels == NULL ) {
+        printf("new sprite error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    memset(sprite->pixels, SPRITE_TRANSPARENT, size);
+}
+
+void FreeSprite(Sprite * sprite)
+{
+    if ( sprite->texture ) {
+        SDL_DestroyTexture(sprite->texture);
+    }
+    
+    if ( !sprite->borrowed ) {
+        free(sprite->pixels);
     }
-                    
-    return sprite;
+    memset(sprite, 0, sizeof(*sprite));
 }
 
-void DrawSprite(SDL_Renderer * renderer, Sprite sprite, SpriteDrawInfo info)
+void DrawSprite(SDL_Renderer * renderer, const Sprite * sprite, const SpriteDrawInfo * info)
 {
     SDL_Rect src = {
-        .x = info.frame * sprite.data.width,
+        .x = info->frame * sprite->width,
         .y = 0,
-        .w = sprite.data.width,
-        .h = sprite.data.height
+        .w = sprite->width,
+        .h = sprite->height
     };
     
-    if ( info.h_flip || info.v_flip || info.angle != 0.0 ) {
+    if ( info->h_flip || info->v_flip || info->angle != 0.0 ) {
         int flip = SDL_FLIP_NONE;
         
-        if ( info.h_flip )
+        if ( info->h_flip )
             flip |= (int)SDL_FLIP_HORIZONTAL;
         
-        if ( info.v_flip )
+        if ( info->v_flip )
             flip |= (int)SDL_FLIP_VERTICAL;
         
         SDL_RenderCopyEx(renderer,
-                         sprite.texture,
+                         sprite->texture,
                          &src,
-                         &info.dst,
+                         &info->dst,
                          0,
                          NULL,
                          (SDL_RendererFlip)flip);
     } else {
-        SDL_RenderCopy(renderer, sprite.texture, &src, &info.dst);
+        SDL_RenderCopy(renderer, sprite->texture, &src, &info->dst);
     }
 }
 
@@ -0,0 +1,351 @@
+/* -----------------------------------------------------------------------------
+ *
+ *  Image comparison, for golden image tests: compares two images, as
+ *  written by --capture, pixel by pixel. Each can be a PPM or a PNG; PNGs
+ *  are only read in the form WritePNG writes them, 8-bit paletted with
+ *  uncompressed deflate blocks. A pixel differs if any channel is
+ *  off by more than the tolerance; the images match if no more than
+ *  max-pixels pixels differ. Exits with 0 on a match, 1 otherwise.
+ *
+ *  With --diff, also writes a PPM of the actual image, dimmed, with the
+ *  differing pixels in red.
+ *
+ *  usage: asteroids_compare [--tolerance N] [--max-pixels N] [--diff FILE]
+ *                           EXPECTED ACTUAL
+ *
+ * -------------------------------------------------------------------------- */
+
+#include "mylib.h"
+#include "array.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    int     width;
+    int     height;
+    u8 *    rgb;
+} image_t;
+
+static bool HasExtension( const char * path, const char * extension ) {
+    size_t path_len = strlen( path );
+    size_t ext_len = strlen( extension );
+    
+    return path_len >= ext_len && strcmp( path + path_len - ext_len, extension ) == 0;
+}
+
+
+static void * Allocate( size_t size ) {
+    void * buffer = malloc( size );
+    if ( buffer == NULL ) {
+        LOG_BAD_MALLOC;
+        exit( EXIT_FAILURE );
+    }
+    
+    return buffer;
+}
+
+
+// binary PPM with 8-bit channels, without comments
+static bool LoadPPM( image_t * image, const char * path ) {
+    FILE * file = fopen( path, "rb" );
+    if ( file == NULL ) {
+        fprintf( stderr, "%s: could not open %s\n", __func__, path );
+        return false;
+    }
+    
+    int max_value;
+    if ( fscanf( file, "P6 %d %d %d", &image->width, &image->height, &max_value ) != 3
+        || max_value != 255
+        || image->width <= 0
+        || image->height <= 0
+        || fgetc( file ) == EOF ) {
+        fprintf( stderr, "%s: %s is not an 8-bit binary PPM\n", __func__, path );
+        fclose( file );
+        return false;
+    }
+    
+    size_t size = (size_t)image->width * image->height * 3;
+    image->rgb = (u8 *)Allocate( size );
+    
+    bool ok = fread( image->rgb, 1, size, file ) == size;
+    fclose( file );
+    
+    if ( !ok ) {
+        fprintf( stderr, "%s: %s is truncated\n", __func__, path );
+        free( image->rgb );
+        return false;
+    }
+    
+    return true;
+}
+
+
+static u32 GetBE32( const u8 * p ) {
+    return (u32)p[0] << 24 | (u32)p[1] << 16 | (u32)p[2] << 8 | p[3];
+}
+
+
+/*
+ * Decode png, size bytes, into image. Only what WritePNG writes: 8-bit
+ * paletted, not interlaced, rows unfiltered, in stored (uncompressed)
+ * deflate blocks. CRCs and the Adler-32 aren't checked; the comparison
+ * would catch damage anyway.
+ */
+static bool DecodePNG( image_t * image, const u8 * png, size_t size ) {
+    static const u8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    
+    if ( size < sizeof signature || memcmp( png, signature, sizeof signature ) != 0 ) {
+        return false;
+    }
+    
+    const u8 * palette = NULL;
+    u32 palette_size = 0;
+    Array<u8> zlib;
+    image->width = 0;
+    
+    size_t offset = sizeof signature;
+    while ( offset + 12 <= size ) {
+        u32 length = GetBE32( png + offset );
+        const u8 * type = png + offset + 4;
+        const u8 * data = png + offset + 8;
+        
+        if ( length > size - offset - 12 ) {
+            return false;
+        }
+        
+        if ( memcmp( type, "IHDR", 4 ) == 0 ) {
+            // 8 bits, indexed color, deflate, standard filters, not interlaced
+            const u8 expected[5] = { 8, 3, 0, 0, 0 };
+            if ( length != 13 || memcmp( data + 8, expected, sizeof expected ) != 0 ) {
+                return false;
+            }
+            image->width = (int)GetBE32( data );
+            image->height = (int)GetBE32( data + 4 );
+        } else if ( memcmp( type, "PLTE", 4 ) == 0 ) {
+            palette = data;
+            palette_size = length / 3;
+        } else if ( memcmp( type, "IDAT", 4 ) == 0 ) {
+            zlib.append_range( data, length );
+        } else if ( memcmp( type, "IEND", 4 ) == 0 ) {
+            break;
+        }
+        
+        offset += length + 12;
+    }
+    
+    if ( image->width <= 0 || image->height <= 0 || palette == NULL ) {
+        return false;
+    }
+    
+    // the zlib header, then stored blocks of rows, each a filter type byte
+    // and the row's indices
+    size_t row_size = (size_t)image->width + 1;
+    size_t rows_size = row_size * image->height;
+    u8 * rows = (u8 *)Allocate( rows_size );
+    size_t rows_count = 0;
+    
+    int in = 2;
+    bool final = false;
+    while ( !final && in + 5 <= zlib.count ) {
+        const u8 * block = zlib.buffer + in;
+        final = block[0] & 1;
+        u32 length = block[1] | block[2] << 8;
+        
+        if ( ( block[0] & 6 ) != 0 // compressed
+            || in + 5 + (int)length > zlib.count
+            || length > rows_size - rows_count ) {
+            free( rows );
+            return false;
+        }
+        
+        memcpy( rows + rows_count, block + 5, length );
+        rows_count += length;
+        in += 5 + length;
+    }
+    
+    if ( rows_count != rows_size ) {
+        free( rows );
+        return false;
+    }
+    
+    image->rgb = (u8 *)Allocate( (size_t)image->width * image->height * 3 );
+    bool ok = true;
+    
+    for ( int y = 0; y < image->height && ok; y++ ) {
+        const u8 * row = rows + y * row_size;
+        ok = row[0] == 0; // no filter
+        
+        for ( int x = 0; x < image->width && ok; x++ ) {
+            u8 index = row[x + 1];
+            ok = index < palette_size;
+            if ( ok ) {
+                memcpy( image->rgb + ( (size_t)y * image->width + x ) * 3, palette + index * 3, 3 );
+            }
+        }
+    }
+    
+    free( rows );
+    if ( !ok ) {
+        free( image->rgb );
+    }
+    
+    return ok;
+}
+
+
+static bool LoadPNG( image_t * image, const char * path ) {
+    FILE * file = fopen( path, "rb" );
+    if ( file == NULL ) {
+        fprintf( stderr, "%s: could not open %s\n", __func__, path );
+        return false;
+    }
+    
+    Array<u8> png( 1 << 16 );
+    u8 buffer[4096];
+    size_t count;
+    while ( ( count = fread( buffer, 1, sizeof buffer, file ) ) > 0 ) {
+        png.append_range( buffer, (int)count );
+    }
+    fclose( file );
+    
+    if ( !DecodePNG( image, png.buffer, png.count ) ) {
+        fprintf( stderr,
+                 "%s: %s is not an uncompressed 8-bit paletted PNG, as --capture writes\n",
+                 __func__,
+                 path );
+        return false;
+    }
+    
+    return true;
+}
+
+
+static bool LoadImage( image_t * image, const char * path ) {
+    if ( HasExtension( path, ".png" ) ) {
+        return LoadPNG( image, path );
+    }
+    
+    return LoadPPM( image, path );
+}
+
+
+static void WriteDiff( const image_t * actual, const u8 * differs, const char * path ) {
+    FILE * file = OpenFile( path, "wb" );
+    fprintf( file, "P6\n%d %d\n255\n", actual->width, actual->height );
+    
+    int num_pixels = actual->width * actual->height;
+    for ( int i = 0; i < num_pixels; i++ ) {
+        u8 rgb[3] = { 255, 0, 0 };
+        
+        if ( !differs[i] ) {
+            for ( int c = 0; c < 3; c++ ) {
+                rgb[c] = actual->rgb[i * 3 + c] / 4;
+            }
+        }
+        
+        fwrite( rgb, 1, 3, file );
+    }
+    
+    if ( fclose( file ) != 0 ) {
+        fprintf( stderr, "%s: could not write %s\n", __func__, path );
+        exit( EXIT_FAILURE );
+    }
+}
+
+
+static void Usage( const char * program ) {
+    fprintf( stderr,
+             "usage: %s [--tolerance N] [--max-pixels N] [--diff FILE] "
+             "EXPECTED ACTUAL\n",
+             program );
+    exit( EXIT_FAILURE );
+}
+
+
+int main( int argc, char ** argv ) {
+    int tolerance = 0;
+    int max_pixels = 0;
+    const char * diff_path = NULL;
+    const char * paths[2];
+    int num_paths = 0;
+    
+    for ( int i = 1; i < argc; i++ ) {
+        if ( strcmp( argv[i], "--tolerance" ) == 0 && i + 1 < argc ) {
+            tolerance = atoi( argv[++i] );
+        } else if ( strcmp( argv[i], "--max-pixels" ) == 0 && i + 1 < argc ) {
+            max_pixels = atoi( argv[++i] );
+        } else if ( strcmp( argv[i], "--diff" ) == 0 && i + 1 < argc ) {
+            diff_path = argv[++i];
+        } else if ( argv[i][0] != '-' && num_paths < 2 ) {
+            paths[num_paths++] = argv[i];
+        } else {
+            Usage( argv[0] );
+        }
+    }
+    
+    if ( num_paths != 2 ) {
+        Usage( argv[0] );
+    }
+    
+    image_t expected;
+    image_t actual;
+    if ( !LoadImage( &expected, paths[0] ) || !LoadImage( &actual, paths[1] ) ) {
+        return EXIT_FAILURE;
+    }
+    
+    if ( expected.width != actual.width || expected.height != actual.height ) {
+        printf( "%s: %dx%d, expected %dx%d\n",
+                paths[1],
+                actual.width,
+                actual.height,
+                expected.width,
+                expected.height );
+        return EXIT_FAILURE;
+    }
+    
+    int num_pixels = actual.width * actual.height;
+    u8 * differs = (u8 *)calloc( num_pixels, 1 );
+    if ( differs == NULL ) {
+        LOG_BAD_MALLOC;
+        exit( EXIT_FAILURE );
+    }
+    
+    int num_different = 0;
+    int max_difference = 0;
+    
+    for ( int i = 0; i < num_pixels; i++ ) {
+        int difference = 0;
+        for ( int c = 0; c < 3; c++ ) {
+            int d = abs( expected.rgb[i * 3 + c] - actual.rgb[i * 3 + c] );
+            difference = MAX( difference, d );
+        }
+        
+        max_difference = MAX( max_difference, difference );
+        if ( difference > tolerance ) {
+            differs[i] = 1;
+            num_different++;
+        }
+    }
+    
+    bool match = num_different <= max_pixels;
+    printf( "%s: %d of %d pixels differ by more than %d (largest difference %d), %s\n",
+            paths[1],
+            num_different,
+            num_pixels,
+            tolerance,
+            max_difference,
+            match ? "ok" : "MISMATCH" );
+    
+    if ( diff_path ) {
+        WriteDiff( &actual, differs, diff_path );
+    }
+    
+    free( differs );
+    free( expected.rgb );
+    free( actual.rgb );
+    
+    return match ? EXIT_SUCCESS : EXIT_FAILURE;
+}
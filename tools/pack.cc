@@ -0,0 +1,151 @@
+/* -----------------------------------------------------------------------------
+ *
+ *  Asset packer: combines the palette and every sprite named in entity_defs
+ *  into one file the game can map at startup. See pack.h for the format.
+ *
+ *  usage: asteroids_pack [OUTPUT]
+ *
+ * -------------------------------------------------------------------------- */
+
+#include "mylib.h"
+
+#define SPRITE_IMPLEMENTATION
+#include "sprite.h"
+
+#include "defines.h"
+#include "entity.h"
+#include "array.h"
+#include "pack.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static Array<packEntry_t> entries;
+static Array<u8> body; // entry data, in order
+
+static bool HaveEntry( const char * name ) {
+    for ( int i = 0; i < entries.count; i++ ) {
+        if ( strcmp( entries.buffer[i].name, name ) == 0 ) {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+
+static void AddEntry( const char * name, const u8 * data, u32 size ) {
+    if ( strlen( name ) >= PACK_NAME_SIZE ) {
+        fprintf( stderr, "%s: name too long: %s\n", __func__, name );
+        exit( EXIT_FAILURE );
+    }
+    
+    packEntry_t entry;
+    memset( &entry, 0, sizeof entry );
+    strcpy( entry.name, name );
+    entry.offset = body.count; // relative to the data for now
+    entry.size = size;
+    entries.append( entry );
+    
+    body.append_range( data, size );
+}
+
+
+static void AddPalette( const char * name ) {
+    Palette palette = LoadPalette( name );
+    
+    u8 data[1 + SPRITE_MAX_COLORS * 3];
+    data[0] = palette.num_colors;
+    for ( int i = 0; i < palette.num_colors; i++ ) {
+        data[1 + i * 3 + 0] = palette.colors[i].r;
+        data[1 + i * 3 + 1] = palette.colors[i].g;
+        data[1 + i * 3 + 2] = palette.colors[i].b;
+    }
+    
+    AddEntry( name, data, 1 + palette.num_colors * 3 );
+}
+
+
+static void AddSprite( const char * name ) {
+    if ( HaveEntry( name ) ) {
+        return;
+    }
+    
+    Sprite sprite;
+    LoadSpriteData( &sprite, name );
+    
+    u32 pixels_size = sprite.width * sprite.height * sprite.num_frames;
+    u32 size = SPRITE_FILE_HEADER_SIZE + pixels_size;
+    
+    u8 * data = (u8 *)malloc( size );
+    if ( data == NULL ) {
+        fprintf( stderr, "%s: malloc failed\n", __func__ );
+        exit( EXIT_FAILURE );
+    }
+    
+    data[0] = sprite.width;
+    data[1] = sprite.height;
+    data[2] = sprite.num_frames;
+    memcpy( data + SPRITE_FILE_HEADER_SIZE, sprite.pixels, pixels_size );
+    
+    AddEntry( name, data, size );
+    
+    free( data );
+    FreeSprite( &sprite );
+}
+
+
+static void WritePack( const char * path ) {
+    u32 data_start = sizeof(packHeader_t) + entries.count * sizeof(packEntry_t);
+    for ( int i = 0; i < entries.count; i++ ) {
+        entries.buffer[i].offset += data_start;
+    }
+    
+    // everything after the header, as it will be in the file
+    u32 size = data_start - sizeof(packHeader_t) + body.count;
+    u8 * contents = (u8 *)malloc( size );
+    if ( contents == NULL ) {
+        fprintf( stderr, "%s: malloc failed\n", __func__ );
+        exit( EXIT_FAILURE );
+    }
+    
+    u32 table_size = entries.count * sizeof(packEntry_t);
+    memcpy( contents, entries.buffer, table_size );
+    memcpy( contents + table_size, body.buffer, body.count );
+    
+    packHeader_t header;
+    memcpy( header.magic, PACK_MAGIC, sizeof header.magic );
+    header.version = PACK_VERSION;
+    header.num_entries = entries.count;
+    header.checksum = PackChecksum( contents, size );
+    
+    FILE * file = OpenFile( path, "wb" );
+    fwrite( &header, sizeof header, 1, file );
+    fwrite( contents, 1, size, file );
+    free( contents );
+    
+    if ( fclose( file ) != 0 ) {
+        fprintf( stderr, "%s: could not write %s\n", __func__, path );
+        exit( EXIT_FAILURE );
+    }
+    
+    printf( "wrote %s: %d entries, %u bytes\n",
+            path,
+            entries.count,
+            data_start + body.count );
+}
+
+
+int main( int argc, char ** argv ) {
+    const char * path = argc > 1 ? argv[1] : PACK_FILE;
+    
+    AddPalette( PALETTE_FILE );
+    for ( int i = 0; i < NUM_ENTITY_TYPES; i++ ) {
+        AddSprite( entity_defs[i].sprite_name );
+    }
+    
+    WritePack( path );
+    
+    return 0;
+}
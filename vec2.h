@@ -1,6 +1,8 @@
 #ifndef vec2_h
 #define vec2_h
 
+#include "fastmath.h"
+
 #include <math.h>
 
 #define VEC_EPSILON 0.001f
@@ -43,13 +45,14 @@ struct vec2_t {
         return true;
     }
 
-    vec2_t rotated( float degrees )
+    vec2_t rotated( float radians ) const
     {
-        float radians = degrees * M_PI / 180.0f;
+        float s, c;
+        FastSinCos( radians, &s, &c );
         
         return (vec2_t){
-            .x = cos(radians) * x - sin(radians) * y,
-            .y = sin(radians) * x + cos(radians) * y
+            .x = c * x - s * y,
+            .y = s * x + c * y
         };
     }
     
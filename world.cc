@@ -1,7 +1,22 @@
 #include "world.h"
 #include "mylib.h"
 #include "game.h"
+#include "player.h"
+#include "profile.h"
 #include <stdio.h>
+#include <math.h>
+#include <string.h>
+
+#define UPDATE_CHUNK_SIZE   256 // entities per job
+#define CONTACT_CHUNK_SIZE  64
+
+// where DeferSpawn and SpawnParticles record to while a chunk of an
+// update runs, NULL for world->commands
+static __thread commandBuffer_t * chunk_commands;
+
+// what WorldRng draws from while a chunk of an update runs, NULL for
+// world->rng
+static __thread rng_t * chunk_rng;
 
 static void InitStars( world_t * world ) {
     const paletteColor_t star_colors[2] = {
@@ -10,13 +25,14 @@ static void InitStars( world_t * world ) {
     };
     
     world->stars = new Array<star_t>( (GAME_WIDTH * GAME_HEIGHT) / 60 );
+    rng_t * rng = WorldRng( world );
     
     for ( int i = 0; i < world->stars->capacity; i++ ) {
         
         star_t star = {
-            .x = Random( 0, GAME_WIDTH ),
-            .y = Random( 0, GAME_HEIGHT ),
-            .color = RANDOM_ELEMENT( star_colors )
+            .x = RngInt( rng, 0, GAME_WIDTH ),
+            .y = RngInt( rng, 0, GAME_HEIGHT ),
+            .color = star_colors[RngInt( rng, 0, array_size( star_colors ) )]
         };
         
         world->stars->append( star );
@@ -31,13 +47,24 @@ world_t * InitWorld( game_t * game ) {
     }
     
     world->game = game;
+    SeedWorld( world, RandomBits() );
     InitStars( world );
-    world->particles = new Array<particle_t>( 1024 );
-    world->entities = new Array<entity_t>( 64 );
+    InitParticles( &world->particles, 1024 );
+    InitEntityPool( &world->entities );
+    InitCommandBuffer( &world->commands );
+    world->chunk_commands = new Array<commandBuffer_t>( 0 );
+    for ( int i = 0; i < NUM_ENTITY_TYPES; i++ ) {
+        world->groups[i] = new Array<entity_t *>( 16 );
+    }
+    world->update_chunks = new Array<updateChunk_t>( 16 );
+    world->contacts = new Array<contact_t>( 64 );
+    world->check_contacts = new Array<contact_t>( 64 );
+    world->swept = new Array<int>( 64 );
+    world->contact_ranges = new Array<contactRange_t>( 64 );
     
     vec2_t player_start = { GAME_WIDTH / 2.0f, GAME_HEIGHT / 2.0f };
     entity_t * player =
-    SpawnEntity( world, ENTITY_PLAYER, player_start, DEG2RAD( 270 ) );
+    SpawnEntity( world, ENTITY_PLAYER, player_start, PLAYER_START_ROTATION );
     player->scale = 0.0f;
     player->state = ES_APPEARING;
     
@@ -47,114 +74,681 @@ world_t * InitWorld( game_t * game ) {
 
 void DestroyWorld( world_t * world ) {    
     delete world->stars;
-    delete world->entities;
-    delete world->particles;
+    FreeEntityPool( &world->entities );
+    FreeCommandBuffer( &world->commands );
+    for ( int i = 0; i < world->chunk_commands->count; i++ ) {
+        FreeCommandBuffer( &world->chunk_commands->buffer[i] );
+    }
+    delete world->chunk_commands;
+    for ( int i = 0; i < NUM_ENTITY_TYPES; i++ ) {
+        delete world->groups[i];
+    }
+    delete world->update_chunks;
+    for ( int i = 0; i < MAX_THREADS; i++ ) {
+        delete world->thread_contacts[i];
+    }
+    FreeParticles( &world->particles );
+    delete world->contacts;
+    delete world->check_contacts;
+    delete world->swept;
+    delete world->contact_ranges;
+    FreeGrid( &world->grid );
+    free( world );
 }
 
 
-void SpawnParticles( world_t * world, particle_t * array, int num ) {
-    for ( int i = 0; i < num; i++ ) {
-        world->particles->append( array[i] );
-    }
+/*
+ * Everything random in the simulation comes from the world's seed, so a
+ * seed and the same input always play out the same way.
+ */
+void SeedWorld( world_t * world, u64 seed ) {
+    world->seed = seed;
+    world->tick = 0;
+    SeedRng( &world->rng, seed, 0 );
 }
 
 
-static void UpdateParticles( world_t * world, float dt ) {
-    for ( int i = 0; i < world->particles->count; i++ ) {
-        particle_t * p = &world->particles->buffer[i];
-        
-        if ( p->lifespan > 0 ) {
-            --p->lifespan;
-            
-            vec2_t velocity = p->velocity * dt;
-            p->position += velocity;
-        }
-    }
+/*
+ * The generator to use for the world. During the update functions, each
+ * chunk of entities has its own stream, seeded from the world's seed, the
+ * tick and the chunk, so the draws don't depend on the number of threads.
+ */
+rng_t * WorldRng( world_t * world ) {
+    return chunk_rng ? chunk_rng : &world->rng;
+}
+
 
-    // remove any whose lifespan is 0
+static commandBuffer_t * Commands( world_t * world ) {
+    return chunk_commands ? chunk_commands : &world->commands;
+}
+
+
+/*
+ * Particles are added at the end of the update.
+ */
+void SpawnParticles( world_t * world, const particle_t * array, int num ) {
+    Commands( world )->particles->append_range( array, num );
+}
+
+
+/*
+ * A new entity of the given type, not yet in the world.
+ */
+entity_t MakeEntity( entityType_t type, vec2_t position, float rotation ) {
+    entity_t entity;
+    memset( &entity, 0, sizeof entity );
     
-    for ( int i = 0; i < world->particles->count; i++) {
-        particle_t * p = &world->particles->buffer[i];
-        
-        if ( p->lifespan <= 0 ) {
-            world->particles->remove( i );
-        }
-    }
+    entity.type         = type;
+    entity.state        = ES_ACTIVE;
+    entity.position     = position;
+    entity.rotation     = rotation;
+    entity.prev_position = position;
+    entity.prev_rotation = rotation;
+    entity.scale        = 1.0f;
+    
+    return entity;
 }
 
 
+/*
+ * Add an entity right away. Only for use outside UpdateWorld; during an
+ * update use DeferSpawn.
+ */
 entity_t * SpawnEntity
  (  world_t * world,
     entityType_t type,
     vec2_t position,
     float rotation )
 {
-    entity_t entity = entity_defs[type];
+    entity_t entity = MakeEntity( type, position, rotation );
+    return AddEntity( &world->entities, &entity );
+}
+
+
+/*
+ * Add an entity at the end of the update. Its first update is the next
+ * one.
+ */
+void DeferSpawn( world_t * world, const entity_t * entity ) {
+    Commands( world )->spawns->append( *entity );
+}
+
+
+/*
+ * The images of an entity's start offset that its path across [0, max_time]
+ * can bring within radius of the point, along one axis: range is the width
+ * or height of the world, and the first and last wrap counts are returned.
+ */
+static void WrapRange
+ (  float offset,
+    float travel,
+    float radius,
+    float range,
+    int * first,
+    int * last )
+{
+    float low = offset + MIN( travel, 0.0f );
+    float high = offset + MAX( travel, 0.0f );
     
-    entity.state        = ES_ACTIVE;
-    entity.position     = position;
-    entity.rotation     = rotation;
-    entity.scale        = 1.0f;
-    entity.world        = world;
-        
-    return world->entities->append( entity );
+    *first = (int)ceilf( ( -radius - high ) / range );
+    *last = (int)floorf( ( radius - low ) / range );
 }
 
 
-void DrawWorld( world_t * world ) {
-    for ( int i = 0; i < world->stars->count; i++ ) {
-        star_t * s = &world->stars->buffer[i];
-        DrawPoint( s->x, s->y, s->color );
+/*
+ * The first active entity to come within radius of point in the next
+ * max_time seconds, moving as it is now and wrapping around the world, or
+ * NULL if none does. The time is written to time if not NULL.
+ *
+ * Nothing is simulated: each entity's straight path is tested against the
+ * point directly, and entities that can't travel far enough are skipped
+ * without solving.
+ */
+entity_t * FirstImpact
+ (  world_t * world,
+    vec2_t point,
+    float radius,
+    float max_time,
+    const entity_t * ignore,
+    float * time )
+{
+    entity_t * first = NULL;
+    float first_time = max_time;
+    
+    for ( int i = 0; i < world->entities.count; i++ ) {
+        entity_t * e = EntityAt( &world->entities, i );
+        
+        if ( e == ignore || e->state != ES_ACTIVE ) {
+            continue;
+        }
+        
+        vec2_t offset = e->position - point;
+        vec2_t travel = e->velocity * first_time;
+        float r = radius + EntityRadius( e );
+        
+        int x0 = 0, x1 = 0;
+        int y0 = 0, y1 = 0;
+        if ( !( EntityFlags( e ) & FL_NO_WRAP ) ) {
+            WrapRange( offset.x, travel.x, r, GAME_WIDTH, &x0, &x1 );
+            WrapRange( offset.y, travel.y, r, GAME_HEIGHT, &y0, &y1 );
+        }
+        
+        for ( int x = x0; x <= x1; x++ ) {
+            for ( int y = y0; y <= y1; y++ ) {
+                vec2_t image = { offset.x + x * GAME_WIDTH, offset.y + y * GAME_HEIGHT };
+                float t = SweepCircle( image, e->velocity, r, first_time );
+                
+                if ( t >= 0.0f && ( first == NULL || t < first_time ) ) {
+                    first = e;
+                    first_time = t;
+                }
+            }
+        }
+    }
+    
+    if ( first && time ) {
+        *time = first_time;
     }
     
-    for ( int i = 0; i < world->entities->count; i++ ) {
-        entity_t * e = &world->entities->buffer[i];
-        DrawEntity( e );
+    return first;
+}
+
+
+// earliest first, then by position
+static int CompareContacts( const void * a, const void * b ) {
+    const contact_t * c1 = (const contact_t *)a;
+    const contact_t * c2 = (const contact_t *)b;
+    
+    if ( c1->time != c2->time ) {
+        return c1->time < c2->time ? -1 : 1;
     }
     
-    for ( int i = 0; i < world->particles->count; i++ ) {
-        particle_t * p = &world->particles->buffer[i];
-        DrawPoint( p->position.x, p->position.y, p->color );
+    if ( c1->a != c2->a ) {
+        return c1->a - c2->a;
     }
+    
+    return c1->b - c2->b;
 }
 
 
-void UpdateWorld( world_t * world, float dt ) {
+typedef struct
+{
+    world_t *   world;
+    int         count; // entities to test
+    bool        grid;
+} contactJob_t;
+
+
+// test a against b, which are at positions i and j, and keep them if they touch
+static void TestPair
+ (  entity_t * a,
+    entity_t * b,
+    int i,
+    int j,
+    Array<contact_t> * contacts )
+{
+    if ( ContactHandler( a, b ) == NULL ) {
+        return; // these types don't interact
+    }
     
-    // update all entities
+    float time = EntitiesTimeOfImpact( a, b );
     
-    for ( int i = 0; i < world->entities->count; i++ ) {
-        entity_t * e = &world->entities->buffer[i];
-        UpdateEntity( e, dt );
+    if ( time >= 0.0f ) {
+        contacts->append( (contact_t){ MIN( i, j ), MAX( i, j ), time } );
     }
+}
+
+
+/*
+ * A swept entity can move past its neighbouring cells in one update, so
+ * search every cell along its path. Two swept entities can both move past
+ * each other's paths, so they're tested against each other directly, from
+ * the lower position of the two.
+ */
+static void FindSweptContacts
+ (  world_t * world,
+    int i,
+    Array<contact_t> * contacts )
+{
+    entityPool_t * entities = &world->entities;
+    grid_t * grid = &world->grid;
+    entity_t * a = EntityAt( entities, i );
+    
+    for ( int n = 0; n < world->swept->count; n++ ) {
+        int j = world->swept->buffer[n];
+        if ( j > i ) {
+            TestPair( a, EntityAt( entities, j ), i, j, contacts );
+        }
+    }
+    
+    vec2_t start = a->prev_position;
+    vec2_t end = start + EntityDisplacement( a );
+    
+    vec2_t min = { MIN( start.x, end.x ), MIN( start.y, end.y ) };
+    vec2_t max = { MAX( start.x, end.x ), MAX( start.y, end.y ) };
     
-    // do entity collisions
+    int box[4];
+    GridBox( grid, min, max, box );
     
-    for ( int i = 0; i < world->entities->count; i++ ) {
-        for ( int j = i + 1; j < world->entities->count; j++ ) {
-            entity_t * a = &world->entities->buffer[i];
-            entity_t * b = &world->entities->buffer[j];
+    for ( int y = box[1]; y <= box[3]; y++ ) {
+        for ( int x = box[0]; x <= box[2]; x++ ) {
+            int cell = GridCell( grid, x, y );
             
-            if ( EntitiesAreColliding( a, b ) ) {
-                if ( a->contact ) {
-                    a->contact(a, b);
+            for ( int k = grid->cell_start[cell]; k < grid->cell_start[cell + 1]; k++ ) {
+                int j = grid->items[k];
+                entity_t * b = EntityAt( entities, j );
+                
+                if ( !( EntityFlags( b ) & FL_SWEPT ) ) {
+                    TestPair( a, b, i, j, contacts );
                 }
-                if ( b->contact ) {
-                    b->contact(b, a);
+            }
+        }
+    }
+}
+
+
+static void FindContactsChunk( void * data, int chunk, int thread ) {
+    contactJob_t * job = (contactJob_t *)data;
+    entityPool_t * entities = &job->world->entities;
+    grid_t * grid = &job->world->grid;
+    Array<contact_t> * contacts = job->world->thread_contacts[thread];
+    contactRange_t * range = &job->world->contact_ranges->buffer[chunk];
+    
+    range->thread = thread;
+    range->start = contacts->count;
+    
+    int start = chunk * CONTACT_CHUNK_SIZE;
+    int end = MIN( start + CONTACT_CHUNK_SIZE, job->count );
+    
+    for ( int i = start; i < end; i++ ) {
+        entity_t * a = EntityAt( entities, i );
+        
+        if ( !job->grid ) {
+            for ( int j = i + 1; j < job->count; j++ ) {
+                TestPair( a, EntityAt( entities, j ), i, j, contacts );
+            }
+            continue;
+        }
+        
+        if ( EntityFlags( a ) & FL_SWEPT ) {
+            FindSweptContacts( job->world, i, contacts );
+            continue;
+        }
+        
+        int neighbors[9];
+        int num_neighbors = GridNeighbors( grid, grid->item_cell[i], neighbors );
+        
+        for ( int n = 0; n < num_neighbors; n++ ) {
+            int cell = neighbors[n];
+            
+            for ( int k = grid->cell_start[cell]; k < grid->cell_start[cell + 1]; k++ ) {
+                int j = grid->items[k];
+                entity_t * b = EntityAt( entities, j );
+                
+                // swept entities find their own contacts
+                if ( j > i && !( EntityFlags( b ) & FL_SWEPT ) ) {
+                    TestPair( a, b, i, j, contacts );
                 }
             }
         }
     }
     
-    // remove any dead entities
+    range->end = contacts->count;
+}
+
+
+/*
+ * Test the first count entities in chunks, across threads, each thread
+ * collecting into its own list. Each chunk's contacts are then joined in
+ * chunk order, so the result doesn't depend on which thread found what,
+ * and sorted by time, then a, then b. Every broadphase finds them in its
+ * own order; sorting them all means they're handled in the same order,
+ * and draw the same random numbers, whichever is used.
+ */
+static void FindContactsParallel
+ (  world_t * world,
+    int count,
+    bool grid,
+    Array<contact_t> * contacts )
+{
+    int num_threads = GetThreadCount();
+    for ( int t = 0; t < num_threads; t++ ) {
+        if ( world->thread_contacts[t] == NULL ) {
+            world->thread_contacts[t] = new Array<contact_t>( 64 );
+        }
+        world->thread_contacts[t]->clear();
+    }
+    
+    if ( grid ) {
+        world->swept->clear();
+        for ( int i = 0; i < count; i++ ) {
+            if ( EntityFlags( EntityAt( &world->entities, i ) ) & FL_SWEPT ) {
+                world->swept->append( i );
+            }
+        }
+    }
+    
+    contactJob_t job = { world, count, grid };
+    int num_chunks = ( count + CONTACT_CHUNK_SIZE - 1 ) / CONTACT_CHUNK_SIZE;
+    
+    Array<contactRange_t> * ranges = world->contact_ranges;
+    ranges->reserve( num_chunks );
+    ranges->count = num_chunks;
+    
+    ParallelFor( num_chunks, FindContactsChunk, &job );
+    
+    int start = contacts->count;
+    for ( int c = 0; c < num_chunks; c++ ) {
+        contactRange_t * r = &ranges->buffer[c];
+        contact_t * list = world->thread_contacts[r->thread]->buffer;
+        contacts->append_range( list + r->start, r->end - r->start );
+    }
     
-    for ( int i = world->entities->count - 1; i >= 0; i-- ) {
-        entity_t * e = &world->entities->buffer[i];
+    qsort( contacts->buffer + start,
+           contacts->count - start,
+           sizeof(contact_t),
+           CompareContacts );
+}
+
+
+static void FindContactsBruteForce
+ (  world_t * world,
+    int count,
+    Array<contact_t> * contacts )
+{
+    FindContactsParallel( world, count, false, contacts );
+}
+
+
+static void FindContactsGrid
+ (  world_t * world,
+    int count,
+    Array<contact_t> * contacts )
+{
+    BuildGrid( &world->grid, &world->entities, count );
+    FindContactsParallel( world, count, true, contacts );
+}
+
+
+static void CrossCheckContacts( world_t * world ) {
+    // both lists are sorted, and must match in order too
+    Array<contact_t> * grid = world->contacts;
+    Array<contact_t> * brute = world->check_contacts;
+    
+    bool match = grid->count == brute->count;
+    for ( int i = 0; match && i < grid->count; i++ ) {
+        if ( CompareContacts( &grid->buffer[i], &brute->buffer[i] ) != 0 ) {
+            match = false;
+        }
+    }
+    
+    if ( !match ) {
+        fprintf( stderr,
+                 "%s: contacts differ: grid found %d, brute force found %d\n",
+                 __func__,
+                 grid->count,
+                 brute->count );
+        
+        for ( int i = 0; i < brute->count; i++ ) {
+            contact_t * c = &brute->buffer[i];
+            fprintf( stderr, "  brute: %d - %d at %g\n", c->a, c->b, c->time );
+        }
+        
+        for ( int i = 0; i < grid->count; i++ ) {
+            contact_t * c = &grid->buffer[i];
+            fprintf( stderr, "  grid:  %d - %d at %g\n", c->a, c->b, c->time );
+        }
+    }
+}
+
+
+/*
+ * Find all touching pairs among the first count entities, in the order they
+ * touched. Entities spawned by contact callbacks are not tested until the
+ * next update.
+ */
+static void FindContacts( world_t * world, int count ) {
+    world->contacts->clear();
+    
+    switch ( world->broadphase ) {
+        case BROADPHASE_GRID:
+            FindContactsGrid( world, count, world->contacts );
+            break;
+        case BROADPHASE_BRUTE_FORCE:
+            FindContactsBruteForce( world, count, world->contacts );
+            break;
+        case BROADPHASE_CROSS_CHECK:
+            world->check_contacts->clear();
+            FindContactsGrid( world, count, world->contacts );
+            FindContactsBruteForce( world, count, world->check_contacts );
+            CrossCheckContacts( world );
+            break;
+    }
+}
+
+
+typedef struct
+{
+    world_t *   world;
+    int         count;
+    float       dt;
+} updateJob_t;
+
+
+static void MoveEntitiesChunk( void * data, int chunk, int thread ) {
+    (void)thread;
+    updateJob_t * job = (updateJob_t *)data;
+    
+    int start = chunk * UPDATE_CHUNK_SIZE;
+    int end = MIN( start + UPDATE_CHUNK_SIZE, job->count );
+    
+    for ( int i = start; i < end; i++ ) {
+        MoveEntity( EntityAt( &job->world->entities, i ), job->dt );
+    }
+}
+
+
+static void UpdateEntitiesChunk( void * data, int chunk, int thread ) {
+    (void)thread;
+    updateJob_t * job = (updateJob_t *)data;
+    updateChunk_t * c = &job->world->update_chunks->buffer[chunk];
+    entity_t ** group = job->world->groups[c->type]->buffer;
+    
+    rng_t rng;
+    SeedRng( &rng, job->world->seed, ( (u64)job->world->tick << 32 | chunk ) + 1 );
+    
+    chunk_commands = &job->world->chunk_commands->buffer[chunk];
+    chunk_rng = &rng;
+    
+    entity_updates[c->type]( job->world, group + c->start, c->end - c->start, job->dt );
+    
+    chunk_commands = NULL;
+    chunk_rng = NULL;
+}
+
+
+/*
+ * Sort the entities whose types have an update into a group per type, in
+ * spawn order, and split each group into chunks. Types without one, most
+ * entities, are skipped entirely.
+ */
+static int GroupEntities( world_t * world ) {
+    for ( int t = 0; t < NUM_ENTITY_TYPES; t++ ) {
+        world->groups[t]->clear();
+    }
+    
+    for ( int i = 0; i < world->entities.count; i++ ) {
+        entity_t * e = EntityAt( &world->entities, i );
+        if ( entity_updates[e->type] ) {
+            world->groups[e->type]->append( e );
+        }
+    }
+    
+    Array<updateChunk_t> * chunks = world->update_chunks;
+    chunks->clear();
+    
+    for ( int t = 0; t < NUM_ENTITY_TYPES; t++ ) {
+        int count = world->groups[t]->count;
         
-        if ( e->state == ES_REMOVE ) {
-            world->entities->remove( i );
+        for ( int start = 0; start < count; start += UPDATE_CHUNK_SIZE ) {
+            int end = MIN( start + UPDATE_CHUNK_SIZE, count );
+            chunks->append( (updateChunk_t){ (entityType_t)t, start, end } );
         }
     }
     
-    UpdateParticles( world, dt );
+    return chunks->count;
+}
+
+
+/*
+ * Move every entity, then run the type updates, each split into chunks
+ * across threads. Updates may read other entities, which have all been
+ * moved by then, but only change their own. Anything they spawn is
+ * recorded per chunk and queued in chunk order, the same order a single
+ * thread would have.
+ */
+void UpdateEntities( world_t * world, float dt ) {
+    updateJob_t job = { world, world->entities.count, dt };
+    int num_chunks = ( job.count + UPDATE_CHUNK_SIZE - 1 ) / UPDATE_CHUNK_SIZE;
+    
+    ParallelFor( num_chunks, MoveEntitiesChunk, &job );
+    
+    num_chunks = GroupEntities( world );
+    
+    Array<commandBuffer_t> * buffers = world->chunk_commands;
+    while ( buffers->count < num_chunks ) {
+        commandBuffer_t commands;
+        InitCommandBuffer( &commands );
+        buffers->append( commands );
+    }
+    
+    ParallelFor( num_chunks, UpdateEntitiesChunk, &job );
+    
+    for ( int i = 0; i < num_chunks; i++ ) {
+        commandBuffer_t * commands = &buffers->buffer[i];
+        world->commands.spawns->append_range( commands->spawns->buffer,
+                                              commands->spawns->count );
+        world->commands.particles->append_range( commands->particles->buffer,
+                                                 commands->particles->count );
+        ClearCommandBuffer( commands );
+    }
+}
+
+
+void CollideEntities( world_t * world ) {
+    FindContacts( world, world->entities.count );
+    
+    // entities don't move in memory and aren't removed until
+    // RemoveDeadEntities, so these stay valid across contact functions
+    // that spawn more
+    for ( int i = 0; i < world->contacts->count; i++ ) {
+        contact_t * c = &world->contacts->buffer[i];
+        entity_t * a = EntityAt( &world->entities, c->a );
+        entity_t * b = EntityAt( &world->entities, c->b );
+        
+        // an earlier contact may have removed one of these
+        if ( EntitiesTimeOfImpact( a, b ) < 0.0f ) {
+            continue;
+        }
+        
+        ContactHandler( a, b )( world, a, b );
+    }
+}
+
+
+void RemoveDeadEntities( world_t * world ) {
+    RemoveEntities( &world->entities );
+}
+
+
+void ApplyCommands( world_t * world ) {
+    ApplyCommandBuffer( &world->commands, &world->entities, &world->particles );
+}
+
+
+void UpdateWorld( world_t * world, float dt ) {
+    
+    {
+        PROFILE_SCOPE( PHASE_INPUT );
+        if ( world->input.poll ) {
+            world->buttons = world->input.poll( world->input.data );
+        } else {
+            world->buttons = 0;
+        }
+    }
+    
+    {
+        PROFILE_SCOPE( PHASE_ENTITY_UPDATE );
+        UpdateEntities( world, dt );
+    }
+    {
+        PROFILE_SCOPE( PHASE_COLLISION );
+        CollideEntities( world );
+    }
+    {
+        PROFILE_SCOPE( PHASE_REMOVAL );
+        RemoveDeadEntities( world );
+    }
+    {
+        PROFILE_SCOPE( PHASE_COMMANDS );
+        ApplyCommands( world );
+    }
+    {
+        PROFILE_SCOPE( PHASE_PARTICLE_UPDATE );
+        UpdateParticleSystem( &world->particles, dt );
+    }
+    
+    ++world->tick;
+}
+
+
+// FNV-1a, continued from hash
+static u32 HashBytes( u32 hash, const void * data, size_t size ) {
+    const u8 * bytes = (const u8 *)data;
+    for ( size_t i = 0; i < size; i++ ) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    
+    return hash;
+}
+
+
+#define HASH(hash, value) HashBytes( hash, &(value), sizeof(value) )
+
+
+/*
+ * A hash of everything that decides how the simulation plays out from
+ * here: the entities, particles, generator state and tick. Two worlds
+ * with the same hash should stay in step given the same input.
+ */
+u32 WorldHash( world_t * world ) {
+    u32 hash = 2166136261u;
+    
+    hash = HASH( hash, world->tick );
+    hash = HASH( hash, world->rng );
+    hash = HASH( hash, world->entities.count );
+    
+    for ( int i = 0; i < world->entities.count; i++ ) {
+        entity_t * e = EntityAt( &world->entities, i );
+        
+        hash = HASH( hash, e->type );
+        hash = HASH( hash, e->state );
+        hash = HASH( hash, e->position );
+        hash = HASH( hash, e->velocity );
+        hash = HASH( hash, e->rotation );
+        hash = HASH( hash, e->angular_speed );
+        hash = HASH( hash, e->scale );
+        if ( e->type == ENTITY_PLAYER ) {
+            hash = HASH( hash, e->info.player );
+        }
+    }
+    
+    particleSystem_t * ps = &world->particles;
+    hash = HASH( hash, ps->count );
+    hash = HashBytes( hash, ps->x, ps->count * sizeof(float) );
+    hash = HashBytes( hash, ps->y, ps->count * sizeof(float) );
+    hash = HashBytes( hash, ps->lifespan, ps->count * sizeof(float) );
+    
+    return hash;
 }
@@ -2,10 +2,16 @@
 #define world_h
 
 #include "defines.h"
-#include "draw.h"
+#include "colors.h"
+#include "input.h"
 #include "array.h"
 #include "vec2.h"
 #include "entity.h"
+#include "grid.h"
+#include "entitypool.h"
+#include "commands.h"
+#include "jobs.h"
+#include "particles.h"
 
 typedef struct
 {
@@ -17,11 +23,36 @@ typedef struct
 
 typedef struct
 {
-    vec2_t          position;
-    vec2_t          velocity;
-    int             lifespan;
-    paletteColor_t    color;
-} particle_t;
+    int             a; // positions in world->entities, a < b
+    int             b;
+    float           time; // when they first touched, as a fraction of the update
+} contact_t;
+
+
+// the contacts one chunk of the narrowphase found
+typedef struct
+{
+    int             thread; // in world->thread_contacts[thread]
+    int             start;
+    int             end;
+} contactRange_t;
+
+
+// a run of one type's update group, for one job
+typedef struct
+{
+    entityType_t    type; // in world->groups[type]
+    int             start;
+    int             end;
+} updateChunk_t;
+
+
+typedef enum
+{
+    BROADPHASE_GRID,
+    BROADPHASE_BRUTE_FORCE,
+    BROADPHASE_CROSS_CHECK, // run both and report any differences
+} broadphase_t;
 
 
 typedef struct entity entity_t;
@@ -32,22 +63,63 @@ typedef struct world
     game_t *            game;
     
     Array<star_t> *     stars;
-    Array<particle_t> * particles;
-    Array<entity_t> *   entities;
+    particleSystem_t    particles;
+    entityPool_t        entities;
+    commandBuffer_t     commands; // applied at the end of each update
+    Array<commandBuffer_t> * chunk_commands; // recorded by each update chunk
+    Array<entity_t *> * groups[NUM_ENTITY_TYPES]; // types with an update
+    Array<updateChunk_t> * update_chunks;
+
+    inputSource_t       input;
+    u32                 buttons; // BUTTON_* flags held this update
+    
+    u64                 seed;
+    u32                 tick; // updates run since seeding
+    rng_t               rng; // use WorldRng() to draw from
+    
+    broadphase_t        broadphase;
+    grid_t              grid;
+    Array<contact_t> *  contacts;
+    Array<contact_t> *  check_contacts;
+    Array<int> *        swept; // positions of FL_SWEPT entities, for the grid
+    Array<contactRange_t> * contact_ranges; // one per chunk
+    Array<contact_t> *  thread_contacts[MAX_THREADS]; // created as needed
 } world_t;
 
 
 world_t *   InitWorld( game_t * game );
 void        DestroyWorld( world_t * world );
 
-void        SpawnParticles( world_t * world, particle_t * array, int num );
-void        DrawWorld( world_t * world );
+void        SeedWorld( world_t * world, u64 seed );
+rng_t *     WorldRng( world_t * world );
+
+u32         WorldHash( world_t * world );
+
+void        SpawnParticles( world_t * world, const particle_t * array, int num );
 void        UpdateWorld( world_t * world, float dt );
 
+// the phases of UpdateWorld, in order
+void        UpdateEntities( world_t * world, float dt );
+void        CollideEntities( world_t * world );
+void        RemoveDeadEntities( world_t * world );
+void        ApplyCommands( world_t * world );
+
+entity_t MakeEntity( entityType_t type, vec2_t position, float rotation );
+
 entity_t * SpawnEntity
  (  world_t * world,
     entityType_t type,
     vec2_t position,
     float rotation );
 
+void DeferSpawn( world_t * world, const entity_t * entity );
+
+entity_t * FirstImpact
+ (  world_t * world,
+    vec2_t point,
+    float radius,
+    float max_time,
+    const entity_t * ignore,
+    float * time );
+
 #endif /* world_h */